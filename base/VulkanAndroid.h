@@ -76,6 +76,7 @@ extern PFN_vkBindImageMemory vkBindImageMemory;
 extern PFN_vkGetImageSubresourceLayout vkGetImageSubresourceLayout;
 extern PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
 extern PFN_vkCmdCopyBufferToImage vkCmdCopyBufferToImage;
+extern PFN_vkCmdFillBuffer vkCmdFillBuffer;
 extern PFN_vkCmdCopyImage vkCmdCopyImage;
 extern PFN_vkCmdBlitImage vkCmdBlitImage;
 extern PFN_vkCmdClearAttachments vkCmdClearAttachments;
@@ -98,6 +99,7 @@ extern PFN_vkCreateFence vkCreateFence;
 extern PFN_vkDestroyFence vkDestroyFence;
 extern PFN_vkWaitForFences vkWaitForFences;
 extern PFN_vkResetFences vkResetFences;
+extern PFN_vkGetFenceStatus vkGetFenceStatus;
 extern PFN_vkCreateCommandPool vkCreateCommandPool;
 extern PFN_vkDestroyCommandPool vkDestroyCommandPool;
 extern PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers;
@@ -109,10 +111,12 @@ extern PFN_vkQueueWaitIdle vkQueueWaitIdle;
 extern PFN_vkDeviceWaitIdle vkDeviceWaitIdle;
 extern PFN_vkCreateFramebuffer vkCreateFramebuffer;
 extern PFN_vkCreatePipelineCache vkCreatePipelineCache;
+extern PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 extern PFN_vkCreatePipelineLayout vkCreatePipelineLayout;
 extern PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines;
 extern PFN_vkCreateComputePipelines vkCreateComputePipelines;
 extern PFN_vkCreateDescriptorPool vkCreateDescriptorPool;
+extern PFN_vkResetDescriptorPool vkResetDescriptorPool;
 extern PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout;
 extern PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets;
 extern PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets;
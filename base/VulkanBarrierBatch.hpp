@@ -0,0 +1,203 @@
+/*
+* Vulkan barrier batch
+*
+* Collects image, buffer and memory barriers with precise stage and access masks and records them with a single pipeline barrier
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+
+namespace vks
+{
+	/**
+	* Batch of barriers that are recorded with one vkCmdPipelineBarrier
+	*
+	* The source and destination stages of all barriers are combined, so only barriers that are required at the same point of a command buffer should be batched
+	* Memory barriers are merged into a single global barrier
+	*
+	* @note A subresource must not be transitioned more than once per batch
+	*/
+	class BarrierBatch
+	{
+	public:
+		/** @brief Shader stages that can sample images without any additional device features */
+		static const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		/**
+		* Get the pipeline stages and accesses of an image layout
+		*
+		* @param layout Image layout
+		* @param source True to get the accesses a transition out of the layout has to wait for (only writes have to be made available), false for the accesses in the new layout
+		* @param stageMask Pointer to the stages that use the layout
+		* @param accessMask Pointer to the accesses in the layout
+		*/
+		static void layoutUsage(VkImageLayout layout, bool source, VkPipelineStageFlags *stageMask, VkAccessFlags *accessMask)
+		{
+			switch (layout)
+			{
+			case VK_IMAGE_LAYOUT_UNDEFINED:
+				// Contents are discarded, there is nothing to wait for
+				*stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				*accessMask = 0;
+				break;
+			case VK_IMAGE_LAYOUT_PREINITIALIZED:
+				*stageMask = VK_PIPELINE_STAGE_HOST_BIT;
+				*accessMask = VK_ACCESS_HOST_WRITE_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+				*stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				*accessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				*stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				*accessMask = source ? 0 : VK_ACCESS_TRANSFER_READ_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+				*stageMask = shaderStages;
+				*accessMask = source ? 0 : VK_ACCESS_SHADER_READ_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+				*stageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+				*accessMask = source ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+				*stageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+				*accessMask = source ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				*stageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				*accessMask = source ? 0 : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+				// Presentation is synchronized with semaphores
+				*stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+				*accessMask = 0;
+				break;
+			default:
+				// Layouts without a specific usage (e.g. general) may be accessed by any command
+				*stageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				*accessMask = source ? VK_ACCESS_MEMORY_WRITE_BIT : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+				break;
+			}
+		}
+
+		/**
+		* Add an image layout transition, the stages and accesses are derived from the layouts
+		*
+		* @param image Image to transition
+		* @param subresourceRange Mip levels and array layers to transition
+		* @param oldLayout Current layout (VK_IMAGE_LAYOUT_UNDEFINED discards the contents)
+		* @param newLayout Layout the image is used with after the barrier
+		*/
+		void addImageTransition(VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout)
+		{
+			VkPipelineStageFlags srcStageMask, dstStageMask;
+			VkAccessFlags srcAccessMask, dstAccessMask;
+			layoutUsage(oldLayout, true, &srcStageMask, &srcAccessMask);
+			layoutUsage(newLayout, false, &dstStageMask, &dstAccessMask);
+			addImageBarrier(image, subresourceRange, oldLayout, newLayout, srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+		}
+
+		/** @brief Add an image barrier with explicit stages and accesses */
+		void addImageBarrier(VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+		{
+			VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+			imageMemoryBarrier.srcAccessMask = srcAccessMask;
+			imageMemoryBarrier.dstAccessMask = dstAccessMask;
+			imageMemoryBarrier.oldLayout = oldLayout;
+			imageMemoryBarrier.newLayout = newLayout;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			imageBarriers.push_back(imageMemoryBarrier);
+			addStages(srcStageMask, dstStageMask);
+		}
+
+		/** @brief Add a barrier for a range of a buffer */
+		void addBufferBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+		{
+			VkBufferMemoryBarrier bufferMemoryBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferMemoryBarrier.srcAccessMask = srcAccessMask;
+			bufferMemoryBarrier.dstAccessMask = dstAccessMask;
+			bufferMemoryBarrier.buffer = buffer;
+			bufferMemoryBarrier.offset = offset;
+			bufferMemoryBarrier.size = size;
+			bufferBarriers.push_back(bufferMemoryBarrier);
+			addStages(srcStageMask, dstStageMask);
+		}
+
+		/** @brief Add a global memory dependency, all memory barriers of the batch are merged into one */
+		void addMemoryBarrier(VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+		{
+			memoryBarrier.srcAccessMask |= srcAccessMask;
+			memoryBarrier.dstAccessMask |= dstAccessMask;
+			hasMemoryBarrier = true;
+			addStages(srcStageMask, dstStageMask);
+		}
+
+		/** @brief Check if the batch contains no barriers */
+		bool empty() const
+		{
+			return !hasMemoryBarrier && imageBarriers.empty() && bufferBarriers.empty();
+		}
+
+		uint32_t memoryBarrierCount() const { return hasMemoryBarrier ? 1 : 0; }
+		uint32_t imageBarrierCount() const { return static_cast<uint32_t>(imageBarriers.size()); }
+		uint32_t bufferBarrierCount() const { return static_cast<uint32_t>(bufferBarriers.size()); }
+
+		/** @brief Record all barriers of the batch (if any) with a single vkCmdPipelineBarrier, the batch is kept */
+		void record(VkCommandBuffer commandBuffer) const
+		{
+			if (empty())
+			{
+				return;
+			}
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				srcStageMask,
+				dstStageMask,
+				0,
+				memoryBarrierCount(), &memoryBarrier,
+				bufferBarrierCount(), bufferBarriers.data(),
+				imageBarrierCount(), imageBarriers.data());
+		}
+
+		/** @brief Record all barriers of the batch and clear it */
+		void flush(VkCommandBuffer commandBuffer)
+		{
+			record(commandBuffer);
+			clear();
+		}
+
+		/** @brief Remove all barriers */
+		void clear()
+		{
+			srcStageMask = 0;
+			dstStageMask = 0;
+			memoryBarrier = vks::initializers::memoryBarrier();
+			hasMemoryBarrier = false;
+			imageBarriers.clear();
+			bufferBarriers.clear();
+		}
+
+	private:
+		VkPipelineStageFlags srcStageMask = 0;
+		VkPipelineStageFlags dstStageMask = 0;
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		bool hasMemoryBarrier = false;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+
+		void addStages(VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages)
+		{
+			// Stage masks must not be empty
+			srcStageMask |= srcStages ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			dstStageMask |= dstStages ? dstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+	};
+}
\ No newline at end of file
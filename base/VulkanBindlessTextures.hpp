@@ -0,0 +1,227 @@
+/*
+* Vulkan bindless texture table
+*
+* Holds the descriptors of all textures in a single descriptor array, shaders select a texture with an index instead of a bound descriptor set
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+
+// VK_EXT_descriptor_indexing is newer than the bundled Vulkan headers, so declare the parts we need here
+#ifndef VK_KHR_maintenance3
+#define VK_KHR_maintenance3 1
+#define VK_KHR_MAINTENANCE3_EXTENSION_NAME "VK_KHR_maintenance3"
+#endif
+
+#ifndef VK_EXT_descriptor_indexing
+#define VK_EXT_descriptor_indexing 1
+#define VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME "VK_EXT_descriptor_indexing"
+#define VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT ((VkStructureType)1000161000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT ((VkStructureType)1000161001)
+#define VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT ((VkDescriptorPoolCreateFlagBits)0x00000002)
+#define VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT ((VkDescriptorSetLayoutCreateFlagBits)0x00000002)
+
+typedef enum VkDescriptorBindingFlagBitsEXT {
+	VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT = 0x00000001,
+	VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT = 0x00000002,
+	VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT = 0x00000004,
+	VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT = 0x00000008,
+	VK_DESCRIPTOR_BINDING_FLAG_BITS_MAX_ENUM_EXT = 0x7FFFFFFF
+} VkDescriptorBindingFlagBitsEXT;
+typedef VkFlags VkDescriptorBindingFlagsEXT;
+
+typedef struct VkDescriptorSetLayoutBindingFlagsCreateInfoEXT {
+	VkStructureType sType;
+	const void* pNext;
+	uint32_t bindingCount;
+	const VkDescriptorBindingFlagsEXT* pBindingFlags;
+} VkDescriptorSetLayoutBindingFlagsCreateInfoEXT;
+
+typedef struct VkPhysicalDeviceDescriptorIndexingFeaturesEXT {
+	VkStructureType sType;
+	void* pNext;
+	VkBool32 shaderInputAttachmentArrayDynamicIndexing;
+	VkBool32 shaderUniformTexelBufferArrayDynamicIndexing;
+	VkBool32 shaderStorageTexelBufferArrayDynamicIndexing;
+	VkBool32 shaderUniformBufferArrayNonUniformIndexing;
+	VkBool32 shaderSampledImageArrayNonUniformIndexing;
+	VkBool32 shaderStorageBufferArrayNonUniformIndexing;
+	VkBool32 shaderStorageImageArrayNonUniformIndexing;
+	VkBool32 shaderInputAttachmentArrayNonUniformIndexing;
+	VkBool32 shaderUniformTexelBufferArrayNonUniformIndexing;
+	VkBool32 shaderStorageTexelBufferArrayNonUniformIndexing;
+	VkBool32 descriptorBindingUniformBufferUpdateAfterBind;
+	VkBool32 descriptorBindingSampledImageUpdateAfterBind;
+	VkBool32 descriptorBindingStorageImageUpdateAfterBind;
+	VkBool32 descriptorBindingStorageBufferUpdateAfterBind;
+	VkBool32 descriptorBindingUniformTexelBufferUpdateAfterBind;
+	VkBool32 descriptorBindingStorageTexelBufferUpdateAfterBind;
+	VkBool32 descriptorBindingUpdateUnusedWhilePending;
+	VkBool32 descriptorBindingPartiallyBound;
+	VkBool32 descriptorBindingVariableDescriptorCount;
+	VkBool32 runtimeDescriptorArray;
+} VkPhysicalDeviceDescriptorIndexingFeaturesEXT;
+#endif
+
+namespace vks
+{
+	/**
+	* Table of combined image samplers in a single descriptor array (set layout binding 0)
+	*
+	* Textures are registered once and referenced by their index, so draws with different textures don't need different descriptor sets
+	* Unused entries of the array are left unwritten (partially bound), so the table can be larger than the number of textures
+	*
+	* @note Without update after bind, textures must not be added or updated while command buffers using the table are pending
+	*/
+	class BindlessTextureTable
+	{
+	public:
+		/** @brief Layout with the descriptor array, to be added to the pipeline layout of the shaders that index the table */
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		/** @brief Set holding the descriptors of all registered textures */
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		/**
+		* Create the descriptor array
+		*
+		* @param device Logical device with VK_EXT_descriptor_indexing enabled (partially bound descriptors and runtime descriptor arrays)
+		* @param capacity Number of entries of the array (must not exceed the per stage sampler and sampled image limits)
+		* @param stages Shader stages that index the table
+		* @param updateAfterBind Allow adding textures while command buffers using the table are pending (requires the update after bind feature for sampled images)
+		* @param allocationCallbacks (Optional) Host allocation callbacks the layout and the pool are created and destroyed with
+		*/
+		void create(VkDevice device, uint32_t capacity, VkShaderStageFlags stages, bool updateAfterBind, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			assert(capacity > 0);
+			this->device = device;
+			this->allocationCallbacks = allocationCallbacks;
+			this->capacity = capacity;
+
+			VkDescriptorSetLayoutBinding binding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, stages, 0, capacity);
+
+			VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+			if (updateAfterBind)
+			{
+				bindingFlags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+			}
+			VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+			bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+			bindingFlagsInfo.bindingCount = 1;
+			bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+			VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(&binding, 1);
+			descriptorLayout.pNext = &bindingFlagsInfo;
+			if (updateAfterBind)
+			{
+				descriptorLayout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+			}
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, allocationCallbacks, &layout));
+
+			VkDescriptorPoolSize poolSize = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity);
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(1, &poolSize, 1);
+			if (updateAfterBind)
+			{
+				descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+			}
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, allocationCallbacks, &pool));
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(pool, &layout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		}
+
+		/**
+		* Register a texture with the table
+		*
+		* @param descriptor Sampler, view and layout of the texture
+		*
+		* @return Index of the texture in the descriptor array, textures with the same view and sampler share an index
+		*/
+		uint32_t add(const VkDescriptorImageInfo &descriptor)
+		{
+			auto key = std::make_pair(descriptor.imageView, descriptor.sampler);
+			auto entry = indices.find(key);
+			if (entry != indices.end())
+			{
+				return entry->second;
+			}
+			if (descriptors.size() >= capacity)
+			{
+				vks::tools::exitFatal("Bindless texture table is full (" + std::to_string(capacity) + " textures)", "Fatal error");
+			}
+			const uint32_t index = static_cast<uint32_t>(descriptors.size());
+			descriptors.push_back(descriptor);
+			indices[key] = index;
+			write(index);
+			return index;
+		}
+
+		/**
+		* Replace the descriptor of a registered texture (e.g. after the image has been relocated)
+		*
+		* @param index Index returned by add()
+		* @param descriptor New sampler, view and layout of the texture
+		*/
+		void update(uint32_t index, const VkDescriptorImageInfo &descriptor)
+		{
+			assert(index < descriptors.size());
+			indices.erase(std::make_pair(descriptors[index].imageView, descriptors[index].sampler));
+			descriptors[index] = descriptor;
+			indices[std::make_pair(descriptor.imageView, descriptor.sampler)] = index;
+			write(index);
+		}
+
+		/** @brief Number of registered textures */
+		uint32_t size() const
+		{
+			return static_cast<uint32_t>(descriptors.size());
+		}
+
+		/** @brief Number of entries of the descriptor array */
+		uint32_t getCapacity() const
+		{
+			return capacity;
+		}
+
+		/** @brief Destroy the descriptor array, the registered textures are not owned by the table */
+		void destroy()
+		{
+			if (device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			vkDestroyDescriptorPool(device, pool, allocationCallbacks);
+			vkDestroyDescriptorSetLayout(device, layout, allocationCallbacks);
+			pool = VK_NULL_HANDLE;
+			layout = VK_NULL_HANDLE;
+			descriptorSet = VK_NULL_HANDLE;
+			descriptors.clear();
+			indices.clear();
+			device = VK_NULL_HANDLE;
+		}
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		uint32_t capacity = 0;
+		std::vector<VkDescriptorImageInfo> descriptors;
+		// View and sampler to index, so textures registered more than once occupy a single entry
+		std::map<std::pair<VkImageView, VkSampler>, uint32_t> indices;
+
+		void write(uint32_t index)
+		{
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &descriptors[index]);
+			writeDescriptorSet.dstArrayElement = index;
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	};
+}
\ No newline at end of file
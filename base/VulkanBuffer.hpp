@@ -11,9 +11,11 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemoryAllocator.hpp"
 
 namespace vks
 {	
@@ -23,6 +25,11 @@ namespace vks
 	*/
 	struct Buffer
 	{
+		Buffer() = default;
+		/** @brief Not copyable, the relocation callbacks of the allocation reference the buffer object (see VulkanDevice::setupBufferRelocation) */
+		Buffer(const Buffer&) = delete;
+		Buffer &operator=(const Buffer&) = delete;
+
 		VkBuffer buffer;
 		VkDevice device;
 		VkDeviceMemory memory;
@@ -35,6 +42,16 @@ namespace vks
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory propertys flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		/** @brief Allocation backing this buffer if created through the VulkanDevice (memory may be a shared block, see allocation->offset) */
+		vks::Allocation *allocation = nullptr;
+		/** @brief Host allocation callbacks the buffer has been created with, also used to destroy it (set by the VulkanDevice) */
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		/** @brief Set to false by the VulkanDevice if the memory type is not host coherent, host writes then need to be flushed */
+		bool hostCoherent = true;
+		/** @brief Alignment of flushed and invalidated ranges for non-coherent memory (device limit) */
+		VkDeviceSize nonCoherentAtomSize = 1;
+		/** @brief Memory ranges (begin, end) written by the host since the last flush, in bytes relative to the start of the memory object */
+		std::vector<std::pair<VkDeviceSize, VkDeviceSize>> dirtyRanges;
 
 		/** 
 		* Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
@@ -90,22 +107,77 @@ namespace vks
 		}
 
 		/**
-		* Copies the specified data to the mapped buffer
+		* Copies the specified data to the mapped buffer and marks the written range as dirty
 		* 
 		* @param data Pointer to the data to copy
 		* @param size Size of the data to copy in machine units
+		* @param offset (Optional) Byte offset from the start of the mapped range
 		*
 		*/
-		void copyTo(void* data, VkDeviceSize size)
+		void copyTo(void* data, VkDeviceSize size, VkDeviceSize offset = 0)
 		{
 			assert(mapped);
-			memcpy(mapped, data, size);
+			memcpy(static_cast<char*>(mapped) + offset, data, size);
+			markDirty(size, offset);
+		}
+
+		/**
+		* Record a range of the buffer that has been written by the host and needs to be flushed before the device reads it
+		*
+		* @note Does nothing for host coherent memory
+		*
+		* @param size (Optional) Size of the written range. Pass VK_WHOLE_SIZE to mark the complete buffer range.
+		* @param offset (Optional) Byte offset from beginning
+		*/
+		void markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
+		{
+			if (hostCoherent)
+			{
+				return;
+			}
+			VkDeviceSize base = allocation ? allocation->offset : 0;
+			VkDeviceSize end = (size == VK_WHOLE_SIZE) ? this->size : std::min(offset + size, this->size);
+			dirtyRanges.push_back({ base + offset, base + end });
+		}
+
+		/**
+		* Append the merged and atom aligned dirty ranges of this buffer to a list of ranges to flush and clear them
+		*
+		* Allows flushing the writes to multiple buffers with a single vkFlushMappedMemoryRanges call
+		*
+		* @param ranges List the mapped memory ranges are added to
+		*/
+		void getDirtyRanges(std::vector<VkMappedMemoryRange> &ranges)
+		{
+			if (dirtyRanges.empty())
+			{
+				return;
+			}
+			std::sort(dirtyRanges.begin(), dirtyRanges.end());
+			VkDeviceSize begin = dirtyRanges[0].first;
+			VkDeviceSize end = dirtyRanges[0].second;
+			for (size_t i = 1; i < dirtyRanges.size(); i++)
+			{
+				// Overlapping or adjacent ranges (after alignment) are combined
+				if (alignDown(dirtyRanges[i].first) <= alignUp(end))
+				{
+					end = std::max(end, dirtyRanges[i].second);
+				}
+				else
+				{
+					ranges.push_back(alignedRange(begin, end));
+					begin = dirtyRanges[i].first;
+					end = dirtyRanges[i].second;
+				}
+			}
+			ranges.push_back(alignedRange(begin, end));
+			dirtyRanges.clear();
 		}
 
 		/** 
-		* Flush a memory range of the buffer to make it visible to the device
+		* Flush a memory range of the buffer together with all recorded dirty ranges to make them visible to the device
 		*
-		* @note Only required for non-coherent memory
+		* @note Only required for non-coherent memory, ranges are aligned to the non-coherent atom size
 		*
 		* @param size (Optional) Size of the memory range to flush. Pass VK_WHOLE_SIZE to flush the complete buffer range.
 		* @param offset (Optional) Byte offset from beginning
@@ -114,18 +186,20 @@ namespace vks
 		*/
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
-			VkMappedMemoryRange mappedRange = {};
-			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
-			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+			markDirty(size, offset);
+			std::vector<VkMappedMemoryRange> mappedRanges;
+			getDirtyRanges(mappedRanges);
+			if (mappedRanges.empty())
+			{
+				return VK_SUCCESS;
+			}
+			return vkFlushMappedMemoryRanges(device, static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
 		}
 
 		/**
 		* Invalidate a memory range of the buffer to make it visible to the host
 		*
-		* @note Only required for non-coherent memory
+		* @note Only required for non-coherent memory, the range is aligned to the non-coherent atom size
 		*
 		* @param size (Optional) Size of the memory range to invalidate. Pass VK_WHOLE_SIZE to invalidate the complete buffer range.
 		* @param offset (Optional) Byte offset from beginning
@@ -134,11 +208,13 @@ namespace vks
 		*/
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
-			VkMappedMemoryRange mappedRange = {};
-			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
+			if (hostCoherent)
+			{
+				return VK_SUCCESS;
+			}
+			VkDeviceSize base = allocation ? allocation->offset : 0;
+			VkDeviceSize end = (size == VK_WHOLE_SIZE) ? this->size : std::min(offset + size, this->size);
+			VkMappedMemoryRange mappedRange = alignedRange(base + offset, base + end);
 			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 		}
 
@@ -149,13 +225,49 @@ namespace vks
 		{
 			if (buffer)
 			{
-				vkDestroyBuffer(device, buffer, nullptr);
+				vkDestroyBuffer(device, buffer, allocationCallbacks);
 			}
 			if (memory)
 			{
-				vkFreeMemory(device, memory, nullptr);
+				if (allocation)
+				{
+					allocation->allocator->free(allocation);
+					allocation = nullptr;
+				}
+				else
+				{
+					vkFreeMemory(device, memory, allocationCallbacks);
+				}
 			}
+			dirtyRanges.clear();
+		}
+
+	private:
+		VkDeviceSize alignDown(VkDeviceSize value)
+		{
+			return value - (value % nonCoherentAtomSize);
+		}
+
+		VkDeviceSize alignUp(VkDeviceSize value)
+		{
+			return alignDown(value + nonCoherentAtomSize - 1);
 		}
 
+		/** @brief Build a mapped memory range covering [begin, end) aligned to the non-coherent atom size, ranges reaching the end of the buffer extend to the end of the memory object */
+		VkMappedMemoryRange alignedRange(VkDeviceSize begin, VkDeviceSize end)
+		{
+			VkMappedMemoryRange mappedRange = {};
+			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			mappedRange.memory = memory;
+			mappedRange.offset = alignDown(begin);
+			mappedRange.size = VK_WHOLE_SIZE;
+			// An aligned end may exceed the memory size, which is not allowed, so the last atom is covered by VK_WHOLE_SIZE instead
+			VkDeviceSize bufferEnd = (allocation ? allocation->offset : 0) + size;
+			if (alignUp(end) < bufferEnd)
+			{
+				mappedRange.size = alignUp(end) - mappedRange.offset;
+			}
+			return mappedRange;
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,426 @@
+/*
+* Vulkan GPU culling and level-of-detail selection
+*
+* Culls instances against the view frustum in a compute shader and writes compacted indirect draw commands for the visible ones
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "frustum.hpp"
+
+namespace vks
+{
+	/**
+	* Compute stage that culls instances of a mesh against the view frustum and selects their level of detail
+	*
+	* Writes one compacted VkDrawIndexedIndirectCommand per visible instance and the number of written commands (draw count) to device buffers
+	* All per frame data (uniforms, draw commands, draw count and statistics) is kept in slices, so frames in flight don't share them
+	*
+	* @note Uses the shader from data/shaders/base/computeculling.comp
+	*/
+	class ComputeCulling
+	{
+	public:
+		/** @brief Max. number of levels of detail per instance that are accounted in the statistics */
+		static const uint32_t maxLodCount = 8;
+
+		/** @brief Culling input of a single instance, matches the layout of the shader's storage buffer */
+		struct Instance
+		{
+			/** @brief Bounding sphere (xyz = center, w = radius) in the space of the frustum planes */
+			glm::vec4 sphere;
+			/** @brief Index of the instance's first level of detail in the level of detail buffer */
+			uint32_t firstLod;
+			/** @brief Number of levels of detail of the instance */
+			uint32_t lodCount;
+			/** @brief First instance of the draw command written for this instance (e.g. to index per instance data in the vertex shader) */
+			uint32_t firstInstance;
+			uint32_t padding = 0;
+		};
+
+		/** @brief Index range of a level of detail, matches the layout of the shader's storage buffer */
+		struct Lod
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+			/** @brief Level of detail is used up to this distance from the camera (the last level is also used beyond) */
+			float distance;
+		};
+
+		/** @brief Draw count and number of visible instances per level of detail written by the culling shader */
+		struct Statistics
+		{
+			uint32_t drawCount;
+			uint32_t lodCounts[maxLodCount];
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		/** @brief Set if the multiDrawIndirect feature has been enabled, used by draw if the draw count can't be read from a buffer */
+		bool multiDrawIndirect = false;
+
+		uint32_t instanceCount = 0;
+		uint32_t sliceCount = 0;
+
+		vks::Buffer instances;
+		vks::Buffer lods;
+		/** @brief Frustum planes and camera position, one slice per frame */
+		vks::Buffer uniforms;
+		/** @brief Compacted draw commands, one slice per frame */
+		vks::Buffer drawCommands;
+		/** @brief Draw count and statistics, one slice per frame */
+		vks::Buffer statistics;
+		/** @brief Host visible copy of the statistics, one slice per frame */
+		vks::Buffer readback;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+
+		/**
+		* Create the culling pipeline and all buffers
+		*
+		* @param device Pointer to the Vulkan device used to create the resources
+		* @param queue Queue used to upload the instance and level of detail data
+		* @param pipelineCache Pipeline cache used to create the compute pipeline
+		* @param shaderStage Compute shader stage with the culling shader, the shader module is not owned by this class
+		* @param instanceData Culling input of all instances
+		* @param lodData Levels of detail referenced by the instances
+		* @param sliceCount Number of per frame slices (e.g. one per swap chain image)
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo shaderStage, std::vector<Instance> &instanceData, std::vector<Lod> &lodData, uint32_t sliceCount)
+		{
+			assert(!instanceData.empty() && !lodData.empty());
+			this->device = device;
+			instanceCount = static_cast<uint32_t>(instanceData.size());
+
+			// Static input, only read by the shader
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&instances,
+				instanceData.size() * sizeof(Instance),
+				instanceData.data(),
+				queue));
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&lods,
+				lodData.size() * sizeof(Lod),
+				lodData.data(),
+				queue));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
+			{
+				// Binding 0 : Instance input
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				// Binding 1 : Levels of detail
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				// Binding 2 : Frustum planes and camera position
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				// Binding 3 : Compacted draw commands
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+				// Binding 4 : Draw count and statistics
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayout, device->allocationCallbacks, &descriptorSetLayout));
+
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCreateInfo, device->allocationCallbacks, &pipelineLayout));
+
+			std::vector<VkDescriptorPoolSize> poolSizes =
+			{
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, device->allocationCallbacks, &descriptorPool));
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			computePipelineCreateInfo.stage = shaderStage;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, device->allocationCallbacks, &pipeline));
+
+			resize(sliceCount);
+		}
+
+		/**
+		* (Re)create the per frame buffers for a new number of slices and update the descriptor set
+		*
+		* @note The device must not use any of the slices anymore
+		*/
+		void resize(uint32_t sliceCount)
+		{
+			if (this->sliceCount == sliceCount)
+			{
+				return;
+			}
+			if (this->sliceCount > 0)
+			{
+				destroySlices();
+			}
+			this->sliceCount = sliceCount;
+
+			// Slices are selected with dynamic offsets, which need to be aligned to the device's min. offset alignments
+			const VkDeviceSize uniformAlignment = device->properties.limits.minUniformBufferOffsetAlignment;
+			const VkDeviceSize storageAlignment = device->properties.limits.minStorageBufferOffsetAlignment;
+			uniformSliceSize = alignUp(sizeof(Uniforms), uniformAlignment);
+			commandSliceSize = alignUp(instanceCount * sizeof(VkDrawIndexedIndirectCommand), storageAlignment);
+			statisticsSliceSize = alignUp(sizeof(Statistics), storageAlignment);
+
+			// Written by the host every frame, cached (possibly non-coherent) memory is preferred
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+				&uniforms,
+				uniformSliceSize * sliceCount));
+			VK_CHECK_RESULT(uniforms.map());
+
+			// Written by the shader and read by the indirect draws (the draw count is also cleared and copied with transfers)
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&drawCommands,
+				commandSliceSize * sliceCount));
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&statistics,
+				statisticsSliceSize * sliceCount));
+
+			// Read by the host once the frame that wrote a slice has finished, cached memory is preferred for reading
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+				&readback,
+				sizeof(Statistics) * sliceCount));
+			VK_CHECK_RESULT(readback.map());
+			// Slices that haven't been written by the device yet read as empty
+			memset(readback.mapped, 0, sizeof(Statistics) * sliceCount);
+			VK_CHECK_RESULT(readback.flush());
+
+			updateDescriptorSet();
+		}
+
+		/** @brief Write the current buffer handles to the descriptor set (e.g. after buffers have been relocated by the defragmentation) */
+		void updateDescriptorSet()
+		{
+			VkDescriptorBufferInfo instanceDescriptor = { instances.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo lodDescriptor = { lods.buffer, 0, VK_WHOLE_SIZE };
+			VkDescriptorBufferInfo uniformDescriptor = { uniforms.buffer, 0, sizeof(Uniforms) };
+			VkDescriptorBufferInfo commandDescriptor = { drawCommands.buffer, 0, instanceCount * sizeof(VkDrawIndexedIndirectCommand) };
+			VkDescriptorBufferInfo statisticsDescriptor = { statistics.buffer, 0, sizeof(Statistics) };
+
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+			{
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &lodDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2, &uniformDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3, &commandDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4, &statisticsDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		/**
+		* Update the frustum planes and camera position of a slice
+		*
+		* @param slice Slice that will be used by the next culling dispatch (must not be in use by the device)
+		* @param frustum Frustum in the space of the instances' bounding spheres
+		* @param cameraPos Camera position in the same space, used for the level of detail selection
+		*/
+		void update(uint32_t slice, const vks::Frustum &frustum, glm::vec3 cameraPos)
+		{
+			assert(slice < sliceCount);
+			Uniforms data;
+			for (uint32_t i = 0; i < 6; i++)
+			{
+				data.frustumPlanes[i] = frustum.planes[i];
+			}
+			data.cameraPos = glm::vec4(cameraPos, 1.0f);
+			data.instanceCount = instanceCount;
+			uniforms.copyTo(&data, sizeof(data), slice * uniformSliceSize);
+			VK_CHECK_RESULT(device->flushMappedBuffers({ &uniforms }));
+		}
+
+		/**
+		* Record the culling dispatch of a slice, must be recorded outside of a render pass before the draws that use the slice
+		*
+		* Also copies the statistics of the slice to host visible memory, see getStatistics
+		*
+		* @note Records the barriers between the steps, use the single steps to synchronize the culling of multiple stages with shared barriers (e.g. with a render graph)
+		*/
+		void recordCulling(VkCommandBuffer commandBuffer, uint32_t slice)
+		{
+			recordReset(commandBuffer, slice);
+
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			recordDispatch(commandBuffer, slice);
+
+			// Make the draw commands and count visible to the indirect draws and the statistics copy
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			recordStatisticsCopy(commandBuffer, slice);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		/** @brief Check if the reset of a slice also clears the draw commands (only required without a draw count buffer) */
+		bool resetsDrawCommands()
+		{
+			return !device->cmdDrawIndexedIndirectCount;
+		}
+
+		/** @brief Record the transfers that reset the draw count and statistics of a slice (transfer writes to drawCommands and statistics) */
+		void recordReset(VkCommandBuffer commandBuffer, uint32_t slice)
+		{
+			assert(slice < sliceCount);
+			// Reset the draw count and statistics, the shader appends to them
+			vkCmdFillBuffer(commandBuffer, statistics.buffer, slice * statisticsSliceSize, sizeof(Statistics), 0);
+			if (resetsDrawCommands())
+			{
+				// Without a draw count buffer all commands of the slice are drawn, commands after the visible ones then draw nothing
+				vkCmdFillBuffer(commandBuffer, drawCommands.buffer, slice * commandSliceSize, instanceCount * sizeof(VkDrawIndexedIndirectCommand), 0);
+			}
+		}
+
+		/** @brief Record the culling dispatch of a slice (compute shader reads and writes drawCommands and statistics) */
+		void recordDispatch(VkCommandBuffer commandBuffer, uint32_t slice)
+		{
+			assert(slice < sliceCount);
+			// Dynamic offsets in binding order: uniforms, draw commands, statistics
+			uint32_t dynamicOffsets[3] = { static_cast<uint32_t>(slice * uniformSliceSize), static_cast<uint32_t>(slice * commandSliceSize), static_cast<uint32_t>(slice * statisticsSliceSize) };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 3, dynamicOffsets);
+			vkCmdDispatch(commandBuffer, (instanceCount + workGroupSize - 1) / workGroupSize, 1, 1);
+		}
+
+		/** @brief Record the copy of a slice's statistics to host visible memory (transfer read of statistics, transfer write to readback) */
+		void recordStatisticsCopy(VkCommandBuffer commandBuffer, uint32_t slice)
+		{
+			assert(slice < sliceCount);
+			// The statistics are read back later without stalling (see getStatistics)
+			VkBufferCopy copyRegion = { slice * statisticsSliceSize, slice * sizeof(Statistics), sizeof(Statistics) };
+			vkCmdCopyBuffer(commandBuffer, statistics.buffer, readback.buffer, 1, &copyRegion);
+		}
+
+		/**
+		* Record the indirect draws of the visible instances of a slice
+		*
+		* @note The pipeline, descriptor sets, vertex and index buffers used for the draws must be bound by the caller
+		*/
+		void draw(VkCommandBuffer commandBuffer, uint32_t slice)
+		{
+			assert(slice < sliceCount);
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			const VkDeviceSize commandOffset = slice * commandSliceSize;
+			const uint32_t maxDrawCount = std::min(instanceCount, device->properties.limits.maxDrawIndirectCount);
+
+			if (device->cmdDrawIndexedIndirectCount)
+			{
+				// Only the visible instances are drawn
+				device->cmdDrawIndexedIndirectCount(commandBuffer, drawCommands.buffer, commandOffset, statistics.buffer, slice * statisticsSliceSize, maxDrawCount, stride);
+			}
+			else if (multiDrawIndirect)
+			{
+				for (uint32_t first = 0; first < instanceCount; first += maxDrawCount)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer, commandOffset + first * stride, std::min(maxDrawCount, instanceCount - first), stride);
+				}
+			}
+			else
+			{
+				// Without multi draw indirect the draw count must be 0 or 1
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffer, drawCommands.buffer, commandOffset + i * stride, 1, stride);
+				}
+			}
+		}
+
+		/**
+		* Read the statistics last written for a slice
+		*
+		* @note Does not wait for the device, the frame that last used the slice must have finished (e.g. after waiting for it's fence)
+		*/
+		void getStatistics(uint32_t slice, Statistics *stats)
+		{
+			assert(slice < sliceCount);
+			VK_CHECK_RESULT(readback.invalidate(sizeof(Statistics), slice * sizeof(Statistics)));
+			memcpy(stats, static_cast<uint8_t*>(readback.mapped) + slice * sizeof(Statistics), sizeof(Statistics));
+		}
+
+		/** @brief Release all Vulkan resources held by the culling stage */
+		void destroy()
+		{
+			if (sliceCount > 0)
+			{
+				destroySlices();
+			}
+			instances.destroy();
+			lods.destroy();
+			vkDestroyPipeline(device->logicalDevice, pipeline, device->allocationCallbacks);
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, device->allocationCallbacks);
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, device->allocationCallbacks);
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, device->allocationCallbacks);
+		}
+
+	private:
+		/** @brief Must match the local size of the culling shader */
+		static const uint32_t workGroupSize = 64;
+
+		/** @brief Uniform block of the culling shader */
+		struct Uniforms
+		{
+			glm::vec4 frustumPlanes[6];
+			glm::vec4 cameraPos;
+			uint32_t instanceCount;
+			uint32_t padding[3];
+		};
+
+		VkDeviceSize uniformSliceSize = 0;
+		VkDeviceSize commandSliceSize = 0;
+		VkDeviceSize statisticsSliceSize = 0;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		void destroySlices()
+		{
+			uniforms.unmap();
+			uniforms.destroy();
+			drawCommands.destroy();
+			statistics.destroy();
+			readback.unmap();
+			readback.destroy();
+			sliceCount = 0;
+		}
+	};
+}
@@ -0,0 +1,271 @@
+/*
+* Vulkan descriptor allocator
+*
+* Allocates descriptor sets from a chain of fixed size pools that grows on demand, whole pools are recycled with vkResetDescriptorPool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+
+namespace vks
+{
+	/**
+	* Growable descriptor set allocator
+	*
+	* Sets are allocated from the current pool until it is exhausted, then the next pool of the chain is used (created if there is none left)
+	* Individual sets are never freed, instead reset() returns all sets at once and keeps the pools for reuse, so the pools never fragment
+	* Persistent sets (allocated once at startup) and transient sets (allocated each frame) should use different allocators
+	*
+	* @note Not thread safe, use one allocator per thread for allocations from multiple threads
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Pool usage, a high number of exhaustions means setsPerPool or the pool ratios are too small */
+		struct Statistics
+		{
+			uint32_t poolsCreated = 0;
+			uint32_t poolsInUse = 0;
+			uint32_t exhaustions = 0;
+			uint32_t allocations = 0;
+			uint32_t resets = 0;
+		};
+
+		DescriptorAllocator() {}
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+		DescriptorAllocator(DescriptorAllocator &&other)
+		{
+			*this = std::move(other);
+		}
+		DescriptorAllocator& operator=(DescriptorAllocator &&other)
+		{
+			destroy();
+			device = other.device;
+			allocationCallbacks = other.allocationCallbacks;
+			setsPerPool = other.setsPerPool;
+			poolRatios = std::move(other.poolRatios);
+			currentPool = other.currentPool;
+			usedPools = std::move(other.usedPools);
+			freePools = std::move(other.freePools);
+			stats = other.stats;
+			other.device = VK_NULL_HANDLE;
+			other.allocationCallbacks = nullptr;
+			other.usedPools.clear();
+			other.freePools.clear();
+			other.currentPool = nullptr;
+			return *this;
+		}
+
+		~DescriptorAllocator()
+		{
+			destroy();
+		}
+
+		/**
+		* Set up the allocator, pools are created on the first allocation
+		*
+		* @param device Logical device to create the pools on
+		* @param setsPerPool Maximum number of sets allocated from a single pool
+		* @param poolRatios Average number of descriptors of each type per set, the pool sizes are these multiplied with setsPerPool
+		* @param allocationCallbacks (Optional) Host allocation callbacks the pools are created and destroyed with
+		*/
+		void init(VkDevice device, uint32_t setsPerPool, const std::vector<VkDescriptorPoolSize> &poolRatios, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			assert(setsPerPool > 0);
+			destroy();
+			this->device = device;
+			this->allocationCallbacks = allocationCallbacks;
+			this->setsPerPool = setsPerPool;
+			this->poolRatios = poolRatios;
+		}
+
+		/**
+		* Allocate a descriptor set, moving on to the next pool if the current one is exhausted
+		*
+		* @param layout Layout of the descriptor set
+		* @param descriptorSet Receives the allocated set
+		* @param descriptorCounts (Optional) Number of descriptors of each type the layout uses (e.g. from ShaderReflection::getPoolSizes), lets the allocator switch pools before the driver reports an exhausted pool
+		*/
+		void allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet, const std::vector<VkDescriptorPoolSize> &descriptorCounts = {})
+		{
+			assert(device != VK_NULL_HANDLE);
+			if ((currentPool == nullptr) || !currentPool->fits(descriptorCounts))
+			{
+				nextPool();
+			}
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(currentPool->pool, &layout, 1);
+			VkResult result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+			if ((result == VK_ERROR_OUT_OF_POOL_MEMORY_KHR) || (result == VK_ERROR_FRAGMENTED_POOL))
+			{
+				// The pool ran out of descriptors of a type the ratios underestimated, a fresh pool must be able to hold the set
+				nextPool();
+				allocInfo.descriptorPool = currentPool->pool;
+				result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+			}
+			VK_CHECK_RESULT(result);
+
+			currentPool->take(descriptorCounts);
+			stats.allocations++;
+		}
+
+		/**
+		* Return all sets allocated since the last reset, the pools are kept for the next allocations
+		*
+		* @note The sets must no longer be in use by the GPU (e.g. the fence of the frame that used them has been waited for)
+		*/
+		void reset()
+		{
+			for (auto& pool : usedPools)
+			{
+				VK_CHECK_RESULT(vkResetDescriptorPool(device, pool.pool, 0));
+				pool.clear();
+				freePools.push_back(pool);
+			}
+			usedPools.clear();
+			currentPool = nullptr;
+			stats.poolsInUse = 0;
+			stats.resets++;
+		}
+
+		/** @brief Destroy all pools, invalidating all sets allocated from them */
+		void destroy()
+		{
+			if (device == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			for (auto& pool : usedPools)
+			{
+				vkDestroyDescriptorPool(device, pool.pool, allocationCallbacks);
+			}
+			for (auto& pool : freePools)
+			{
+				vkDestroyDescriptorPool(device, pool.pool, allocationCallbacks);
+			}
+			usedPools.clear();
+			freePools.clear();
+			currentPool = nullptr;
+			stats.poolsInUse = 0;
+		}
+
+		/** @brief Get the pool statistics since the allocator has been created */
+		const Statistics& getStatistics() const
+		{
+			return stats;
+		}
+
+	private:
+		struct Pool
+		{
+			VkDescriptorPool pool;
+			uint32_t maxSets;
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			uint32_t setsLeft;
+			// Descriptors left per type, only tracked for allocations that pass their descriptor counts
+			std::vector<VkDescriptorPoolSize> descriptorsLeft;
+
+			bool fits(const std::vector<VkDescriptorPoolSize> &descriptorCounts) const
+			{
+				if (setsLeft == 0)
+				{
+					return false;
+				}
+				for (auto& count : descriptorCounts)
+				{
+					uint32_t left = 0;
+					for (auto& size : descriptorsLeft)
+					{
+						if (size.type == count.type)
+						{
+							left = size.descriptorCount;
+						}
+					}
+					if (left < count.descriptorCount)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+			void take(const std::vector<VkDescriptorPoolSize> &descriptorCounts)
+			{
+				setsLeft--;
+				for (auto& count : descriptorCounts)
+				{
+					for (auto& size : descriptorsLeft)
+					{
+						if (size.type == count.type)
+						{
+							size.descriptorCount -= std::min(size.descriptorCount, count.descriptorCount);
+						}
+					}
+				}
+			}
+
+			void clear()
+			{
+				setsLeft = maxSets;
+				descriptorsLeft = poolSizes;
+			}
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		uint32_t setsPerPool = 0;
+		std::vector<VkDescriptorPoolSize> poolRatios;
+		// Pools sets have been allocated from since the last reset, the last one is the current pool
+		std::vector<Pool> usedPools;
+		// Pools that have been reset and can be reused
+		std::vector<Pool> freePools;
+		Pool *currentPool = nullptr;
+		Statistics stats;
+
+		/** @brief Make the next free pool the current one, creates a new pool if there is none left */
+		void nextPool()
+		{
+			if (currentPool != nullptr)
+			{
+				stats.exhaustions++;
+			}
+
+			Pool pool;
+			if (!freePools.empty())
+			{
+				pool = freePools.back();
+				freePools.pop_back();
+			}
+			else
+			{
+				pool.maxSets = setsPerPool;
+				for (auto& ratio : poolRatios)
+				{
+					pool.poolSizes.push_back(vks::initializers::descriptorPoolSize(ratio.type, std::max(1u, ratio.descriptorCount * setsPerPool)));
+				}
+				VkDescriptorPoolCreateInfo descriptorPoolInfo =
+					vks::initializers::descriptorPoolCreateInfo(
+						static_cast<uint32_t>(pool.poolSizes.size()),
+						pool.poolSizes.data(),
+						setsPerPool);
+				VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, allocationCallbacks, &pool.pool));
+				pool.clear();
+				stats.poolsCreated++;
+			}
+
+			usedPools.push_back(pool);
+			currentPool = &usedPools.back();
+			stats.poolsInUse = static_cast<uint32_t>(usedPools.size());
+		}
+	};
+}
\ No newline at end of file
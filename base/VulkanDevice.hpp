@@ -13,9 +13,19 @@
 #include <exception>
 #include <assert.h>
 #include <algorithm>
+#include <memory>
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
 #include "VulkanBuffer.hpp"
+#include "VulkanMemoryTracker.hpp"
+#include "VulkanMemoryAllocator.hpp"
+#include "VulkanBindlessTextures.hpp"
+
+// VK_KHR_draw_indirect_count is newer than the bundled Vulkan headers, the entry point matches the one of VK_AMD_draw_indirect_count
+#ifndef VK_KHR_draw_indirect_count
+#define VK_KHR_draw_indirect_count 1
+#define VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME "VK_KHR_draw_indirect_count"
+#endif
 
 namespace vks
 {	
@@ -42,6 +52,39 @@ namespace vks
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
 
+		/** @brief Host allocation callbacks used for the logical device and the objects created by this class (nullptr for the driver's default allocator), must be set before createLogicalDevice */
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		/** @brief Set if the main device local heap is also host visible (integrated GPUs, resizable BAR), device local buffers can then be written directly without staging */
+		bool hostVisibleDeviceLocalMemory = false;
+
+		/** @brief Set to true when the memory budget extension has been enabled */
+		bool enableMemoryBudget = false;
+		/** @brief Instance level entry point required to read memory budgets, must be set before creating the logical device to enable VK_EXT_memory_budget */
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+		/** @brief Instance level entry point required to query extension features, must be set before creating the logical device to enable VK_EXT_descriptor_indexing */
+		PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 = nullptr;
+		/** @brief Descriptor indexing features enabled for bindless descriptor arrays (VK_EXT_descriptor_indexing) */
+		struct
+		{
+			/** @brief Set if partially bound runtime descriptor arrays of combined image samplers can be indexed non-uniformly */
+			bool enabled = false;
+			/** @brief Set if sampled image descriptors of such arrays can be written while command buffers using them are pending */
+			bool updateAfterBind = false;
+		} descriptorIndexing;
+		/** @brief Draw indexed indirect with a draw count read from a buffer, set if VK_KHR_draw_indirect_count or VK_AMD_draw_indirect_count has been enabled (nullptr otherwise) */
+		PFN_vkCmdDrawIndexedIndirectCountAMD cmdDrawIndexedIndirectCount = nullptr;
+		/** @brief Accounts all device memory allocated through this device per heap and category */
+		vks::MemoryTracker memoryTracker;
+		/** @brief Sub-allocates device local resources from larger blocks (see beginDefragmentation) */
+		vks::MemoryAllocator memoryAllocator;
+		/** @brief Defragmentation step whose copies have been submitted, but whose moves have not been committed yet */
+		struct
+		{
+			std::vector<vks::MemoryAllocator::Move> moves;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+		} defragmentation;
+
 		/** @brief Contains queue family indices */
 		struct
 		{
@@ -70,6 +113,24 @@ namespace vks
 			vkGetPhysicalDeviceFeatures(physicalDevice, &features);
 			// Memory properties are used regularly for creating all kinds of buffers
 			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			// Check if the largest device local heap can be written by the host directly
+			// Small host visible device local heaps (e.g. the 256 MB BAR window of discrete GPUs) are left for streaming data
+			VkDeviceSize largestDeviceLocalHeap = 0;
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				{
+					largestDeviceLocalHeap = std::max(largestDeviceLocalHeap, memoryProperties.memoryHeaps[i].size);
+				}
+			}
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+				if (((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags) && (memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size >= largestDeviceLocalHeap))
+				{
+					hostVisibleDeviceLocalMemory = true;
+				}
+			}
 			// Queue family properties, used for setting up requested queues upon device creation
 			uint32_t queueFamilyCount;
 			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -100,13 +161,16 @@ namespace vks
 		*/
 		~VulkanDevice()
 		{
+			// The owners of the moved resources may be gone, so the pending moves are discarded instead of committed
+			abortDefragmentation();
+			memoryAllocator.destroy();
 			if (commandPool)
 			{
-				vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+				vkDestroyCommandPool(logicalDevice, commandPool, allocationCallbacks);
 			}
 			if (logicalDevice)
 			{
-				vkDestroyDevice(logicalDevice, nullptr);
+				vkDestroyDevice(logicalDevice, allocationCallbacks);
 			}
 		}
 
@@ -317,23 +381,115 @@ namespace vks
 				enableDebugMarkers = true;
 			}
 
+			// Enable the memory budget extension if the driver supports it and the instance exposes the properties2 entry points
+			if (getPhysicalDeviceMemoryProperties2 && extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+			{
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				enableMemoryBudget = true;
+			}
+
+			// Enable reading the draw count of indirect draws from a buffer (e.g. written by GPU culling), preferring the KHR extension
+			const char *drawIndirectCountExtension = nullptr;
+			if (extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+			{
+				drawIndirectCountExtension = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+			}
+			else if (extensionSupported(VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+			{
+				drawIndirectCountExtension = VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+			}
+			if (drawIndirectCountExtension)
+			{
+				deviceExtensions.push_back(drawIndirectCountExtension);
+			}
+
+			// Enable the descriptor indexing features needed for bindless texture arrays, if the driver supports all of them
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+			descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			if (getPhysicalDeviceFeatures2 && extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+			{
+				VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+				supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+				VkPhysicalDeviceFeatures2KHR features2{};
+				features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+				features2.pNext = &supportedFeatures;
+				getPhysicalDeviceFeatures2(physicalDevice, &features2);
+				if (supportedFeatures.runtimeDescriptorArray && supportedFeatures.descriptorBindingPartiallyBound && supportedFeatures.shaderSampledImageArrayNonUniformIndexing)
+				{
+					descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+					descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+					descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+					descriptorIndexing.enabled = true;
+					if (supportedFeatures.descriptorBindingSampledImageUpdateAfterBind && supportedFeatures.descriptorBindingUpdateUnusedWhilePending)
+					{
+						descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+						descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+						descriptorIndexing.updateAfterBind = true;
+					}
+					deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+					deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+					deviceCreateInfo.pNext = &descriptorIndexingFeatures;
+				}
+			}
+
 			if (deviceExtensions.size() > 0)
 			{
 				deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
 				deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 			}
 
-			VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
+			VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, allocationCallbacks, &logicalDevice);
 
 			if (result == VK_SUCCESS)
 			{
 				// Create a default command pool for graphics command buffers
 				commandPool = createCommandPool(queueFamilyIndices.graphics);
+				if (drawIndirectCountExtension)
+				{
+					const char *entryPoint = (strcmp(drawIndirectCountExtension, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) ? "vkCmdDrawIndexedIndirectCountKHR" : "vkCmdDrawIndexedIndirectCountAMD";
+					cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountAMD>(vkGetDeviceProcAddr(logicalDevice, entryPoint));
+				}
+				memoryTracker.init(physicalDevice, logicalDevice, enableMemoryBudget ? getPhysicalDeviceMemoryProperties2 : nullptr, allocationCallbacks);
+				memoryAllocator.init(logicalDevice, memoryProperties, &memoryTracker);
 			}
 
 			return result;
 		}
 
+		/**
+		* Allocate device memory that is accounted in the memory statistics of this device
+		*
+		* @param allocateInfo Allocation info as passed to vkAllocateMemory
+		* @param category Category the allocation is accounted to (geometry, textures, uniforms, etc.)
+		* @param memory Pointer to the memory handle acquired by the function
+		*
+		* @return VkResult of the allocation
+		*
+		* @note Memory allocated with this function must be released with freeMemory
+		*/
+		VkResult allocateMemory(const VkMemoryAllocateInfo *allocateInfo, vks::MemoryCategory category, VkDeviceMemory *memory)
+		{
+			return memoryTracker.allocate(allocateInfo, category, memory);
+		}
+
+		/** @brief Free device memory previously allocated with allocateMemory */
+		void freeMemory(VkDeviceMemory memory)
+		{
+			memoryTracker.free(memory);
+		}
+
+		/**
+		* Get a snapshot of the current device memory usage
+		*
+		* @return Per heap sizes, budgets and usage along with the bytes allocated per category
+		*
+		* @note Budget and usage are read from VK_EXT_memory_budget if enabled, otherwise the heap size and the tracked allocations are reported
+		*/
+		vks::MemoryStatistics getMemoryStatistics()
+		{
+			return memoryTracker.getStatistics();
+		}
+
 		/**
 		* Create a buffer on the device
 		*
@@ -345,13 +501,15 @@ namespace vks
 		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 		*
 		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+		*
+		* @note The buffer is created with allocationCallbacks and has to be destroyed with them
 		*/
 		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr)
 		{
 			// Create the buffer handle
 			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, allocationCallbacks, buffer));
 
 			// Create the memory backing up the buffer handle
 			VkMemoryRequirements memReqs;
@@ -360,7 +518,7 @@ namespace vks
 			memAlloc.allocationSize = memReqs.size;
 			// Find a memory type index that fits the properties of the buffer
 			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, memory));
+			VK_CHECK_RESULT(allocateMemory(&memAlloc, vks::memoryCategoryFromUsage(usageFlags), memory));
 			
 			// If a pointer to the buffer data has been passed, map the buffer and copy over the data
 			if (data != nullptr)
@@ -368,13 +526,14 @@ namespace vks
 				void *mapped;
 				VK_CHECK_RESULT(vkMapMemory(logicalDevice, *memory, 0, size, 0, &mapped));
 				memcpy(mapped, data, size);
-				// If host coherency hasn't been requested, do a manual flush to make writes visible
-				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+				// If the memory type isn't host coherent, do a manual flush to make writes visible
+				// The whole allocation is flushed as the size may not be a multiple of the non-coherent atom size
+				if ((memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
 				{
 					VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
 					mappedRange.memory = *memory;
 					mappedRange.offset = 0;
-					mappedRange.size = size;
+					mappedRange.size = VK_WHOLE_SIZE;
 					vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
 				}
 				vkUnmapMemory(logicalDevice, *memory);
@@ -390,7 +549,7 @@ namespace vks
 		* Create a buffer on the device
 		*
 		* @param usageFlags Usage flag bitmask for the buffer (i.e. index, vertex, uniform buffer)
-		* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+		* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent), host cached is treated as a preference and falls back to coherent memory
 		* @param buffer Pointer to a vk::Vulkan buffer object
 		* @param size Size of the buffer in byes
 		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
@@ -400,38 +559,283 @@ namespace vks
 		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr)
 		{
 			buffer->device = logicalDevice;
+			buffer->allocationCallbacks = allocationCallbacks;
+
+			// Buffers that are not host visible can be moved by the memory defragmentation, which copies them on the device
+			const bool relocatable = (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0;
+			if (relocatable)
+			{
+				usageFlags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			}
 
 			// Create the buffer handle
 			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
-			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, allocationCallbacks, &buffer->buffer));
 
 			// Create the memory backing up the buffer handle
 			VkMemoryRequirements memReqs;
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 			vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
 			// Find a memory type index that fits the properties of the buffer
-			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+			VkBool32 memoryTypeFound = false;
+			uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags, &memoryTypeFound);
+			if (!memoryTypeFound && (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+			{
+				// Cached memory is only a preference for host written streaming data, fall back to coherent memory
+				memoryPropertyFlags = (memoryPropertyFlags & ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT) | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			}
+			if (!memoryTypeFound)
+			{
+				memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+			}
+			buffer->allocation = memoryAllocator.allocate(memReqs, memoryTypeIndex, vks::memoryCategoryFromUsage(usageFlags), true);
+			if (!buffer->allocation)
+			{
+				return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+			}
+			buffer->memory = buffer->allocation->memory;
 
 			buffer->alignment = memReqs.alignment;
-			buffer->size = memAlloc.allocationSize;
+			buffer->size = memReqs.size;
 			buffer->usageFlags = usageFlags;
 			buffer->memoryPropertyFlags = memoryPropertyFlags;
+			buffer->hostCoherent = (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+			buffer->nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
 
 			// If a pointer to the buffer data has been passed, map the buffer and copy over the data
 			if (data != nullptr)
 			{
 				VK_CHECK_RESULT(buffer->map());
-				memcpy(buffer->mapped, data, size);
+				buffer->copyTo(data, size);
+				// Make the writes visible if the memory is not host coherent
+				VK_CHECK_RESULT(buffer->flush());
 				buffer->unmap();
 			}
 
 			// Initialize a default descriptor that covers the whole buffer size
 			buffer->setupDescriptor();
 
+			if (relocatable)
+			{
+				setupBufferRelocation(buffer, bufferCreateInfo);
+			}
+
 			// Attach the memory to the buffer object
-			return buffer->bind();
+			return buffer->bind(buffer->allocation->offset);
+		}
+
+		/**
+		* Register the callbacks that allow the defragmentation to move a buffer to a new memory location
+		*
+		* @note The callbacks reference the buffer object, which is why vks::Buffer can't be copied (or moved)
+		* @note The buffer created at the new location is owned by the callbacks until the move is committed, so a discarded move doesn't need the buffer object
+		*/
+		void setupBufferRelocation(vks::Buffer *buffer, VkBufferCreateInfo bufferCreateInfo)
+		{
+			VkDevice device = logicalDevice;
+			const VkAllocationCallbacks *callbacks = allocationCallbacks;
+			std::shared_ptr<VkBuffer> target = std::make_shared<VkBuffer>();
+			buffer->allocation->copy = [device, buffer, bufferCreateInfo, target](VkCommandBuffer copyCmd, VkDeviceMemory memory, VkDeviceSize offset)
+			{
+				VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, buffer->allocationCallbacks, target.get()));
+				VK_CHECK_RESULT(vkBindBufferMemory(device, *target, memory, offset));
+				VkBufferCopy copyRegion = { 0, 0, bufferCreateInfo.size };
+				vkCmdCopyBuffer(copyCmd, buffer->buffer, *target, 1, &copyRegion);
+			};
+			buffer->allocation->commit = [device, buffer, target]()
+			{
+				vkDestroyBuffer(device, buffer->buffer, buffer->allocationCallbacks);
+				buffer->buffer = *target;
+				buffer->memory = buffer->allocation->memory;
+				buffer->descriptor.buffer = buffer->buffer;
+			};
+			buffer->allocation->discard = [device, callbacks, target]()
+			{
+				vkDestroyBuffer(device, *target, callbacks);
+			};
+		}
+
+		/**
+		* Start a step of the device memory defragmentation
+		*
+		* Plans the relocation of buffers and textures out of the least used memory blocks and submits the device copies without waiting for them
+		* The moved resources stay valid at their old location until the step is finished with endDefragmentation
+		*
+		* @param queue Queue used for the copy commands (must support transfer)
+		* @param maxBytesToMove Budget for the number of bytes copied in this step (e.g. per frame)
+		*
+		* @return True if copies have been submitted, false if there is nothing to move
+		*
+		* @note Only one step can be pending at a time, resources moved by a pending step must not be destroyed before the step has been finished (or aborted)
+		*/
+		bool beginDefragmentation(VkQueue queue, VkDeviceSize maxBytesToMove)
+		{
+			assert(!defragmentationPending());
+			std::vector<vks::MemoryAllocator::Move> moves = memoryAllocator.beginDefragmentation(maxBytesToMove);
+			if (moves.empty())
+			{
+				return false;
+			}
+
+			VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+			// Work submitted earlier to the same queue may still write the resources
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			for (auto& move : moves)
+			{
+				move.allocation->copy(copyCmd, move.block->memory, move.offset);
+			}
+
+			// Make the copied contents visible to all following commands
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, allocationCallbacks, &defragmentation.fence));
+
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &copyCmd;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, defragmentation.fence));
+
+			defragmentation.commandBuffer = copyCmd;
+			defragmentation.moves = moves;
+			return true;
+		}
+
+		/** @brief Check if a defragmentation step has been started and not finished yet */
+		bool defragmentationPending() const
+		{
+			return defragmentation.fence != VK_NULL_HANDLE;
+		}
+
+		/** @brief Check if the copies of the pending defragmentation step have finished executing (does not block) */
+		bool defragmentationCopiesFinished()
+		{
+			return defragmentationPending() && (vkGetFenceStatus(logicalDevice, defragmentation.fence) == VK_SUCCESS);
+		}
+
+		/**
+		* Finish the pending defragmentation step
+		*
+		* Switches the moved resources to their new location, destroys the old resources and releases memory blocks that became empty
+		* Waits for the copies if they haven't finished yet
+		*
+		* @return Statistics of the step, if allocationsMoved is not zero the handles of moved resources changed and descriptor sets and command buffers referencing them must be updated
+		*
+		* @note The old resources are destroyed immediately, so no submitted work may still use them (e.g. wait for all frames in flight first)
+		*/
+		vks::DefragmentationStats endDefragmentation()
+		{
+			if (!defragmentationPending())
+			{
+				return vks::DefragmentationStats();
+			}
+			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &defragmentation.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			vkDestroyFence(logicalDevice, defragmentation.fence, allocationCallbacks);
+			vkFreeCommandBuffers(logicalDevice, commandPool, 1, &defragmentation.commandBuffer);
+			defragmentation.fence = VK_NULL_HANDLE;
+			defragmentation.commandBuffer = VK_NULL_HANDLE;
+
+			vks::DefragmentationStats stats = memoryAllocator.endDefragmentation(defragmentation.moves);
+			defragmentation.moves.clear();
+			return stats;
+		}
+
+		/**
+		* Abandon the pending defragmentation step, all resources stay at their old location
+		*
+		* Waits for the copies if they haven't finished yet and destroys the resources created at the new locations
+		*/
+		void abortDefragmentation()
+		{
+			if (!defragmentationPending())
+			{
+				return;
+			}
+			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &defragmentation.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			vkDestroyFence(logicalDevice, defragmentation.fence, allocationCallbacks);
+			vkFreeCommandBuffers(logicalDevice, commandPool, 1, &defragmentation.commandBuffer);
+			defragmentation.fence = VK_NULL_HANDLE;
+			defragmentation.commandBuffer = VK_NULL_HANDLE;
+
+			memoryAllocator.abortDefragmentation(defragmentation.moves);
+			defragmentation.moves.clear();
+		}
+
+		/**
+		* Flush the host writes recorded for a list of mapped buffers with a single call
+		*
+		* Dirty ranges are aligned to the non-coherent atom size and merged, buffers in host coherent memory are skipped
+		*
+		* @param buffers List of buffers that may have been written by the host (e.g. all per-frame uniform buffers)
+		*
+		* @return VkResult of the flush call
+		*/
+		VkResult flushMappedBuffers(const std::vector<vks::Buffer*> &buffers)
+		{
+			std::vector<VkMappedMemoryRange> mappedRanges;
+			for (auto buffer : buffers)
+			{
+				buffer->getDirtyRanges(mappedRanges);
+			}
+			if (mappedRanges.empty())
+			{
+				return VK_SUCCESS;
+			}
+			return vkFlushMappedMemoryRanges(logicalDevice, static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
+		}
+
+		/**
+		* Create a device local buffer and fill it with the passed data
+		*
+		* If device local memory is host visible the data is written directly into the buffer, otherwise it's uploaded through a staging buffer
+		*
+		* @param usageFlags Usage flag bitmask for the buffer (i.e. index, vertex, uniform buffer)
+		* @param buffer Pointer to a vk::Vulkan buffer object
+		* @param size Size of the buffer in bytes
+		* @param data Pointer to the data that is copied to the buffer
+		* @param copyQueue Queue used for the staging copy (must support transfer)
+		*
+		* @return VK_SUCCESS if the buffer has been created and the data has been uploaded
+		*/
+		VkResult createDeviceLocalBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, VkQueue copyQueue)
+		{
+			assert(data);
+
+			// Direct write, no staging allocation, copy command or fence wait required
+			if (hostVisibleDeviceLocalMemory)
+			{
+				VkResult result = createBuffer(usageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, buffer, size);
+				if (result != VK_SUCCESS)
+				{
+					return result;
+				}
+				VK_CHECK_RESULT(buffer->map());
+				buffer->copyTo(data, size);
+				VK_CHECK_RESULT(buffer->flush());
+				buffer->unmap();
+				return VK_SUCCESS;
+			}
+
+			vks::Buffer stagingBuffer;
+			VK_CHECK_RESULT(createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, size, data));
+			VkResult result = createBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, size);
+			if (result == VK_SUCCESS)
+			{
+				VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				VkBufferCopy copyRegion = { 0, 0, size };
+				vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer->buffer, 1, &copyRegion);
+				flushCommandBuffer(copyCmd, copyQueue);
+			}
+			stagingBuffer.destroy();
+			return result;
 		}
 
 		/**
@@ -471,6 +875,7 @@ namespace vks
 		* @param createFlags (Optional) Command pool creation flags (Defaults to VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)
 		*
 		* @note Command buffers allocated from the created pool can only be submitted to a queue with the same family index
+		* @note The pool is created with allocationCallbacks and has to be destroyed with them
 		*
 		* @return A handle to the created command buffer
 		*/
@@ -481,7 +886,7 @@ namespace vks
 			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
 			cmdPoolInfo.flags = createFlags;
 			VkCommandPool cmdPool;
-			VK_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &cmdPoolInfo, nullptr, &cmdPool));
+			VK_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &cmdPoolInfo, allocationCallbacks, &cmdPool));
 			return cmdPool;
 		}
 
@@ -536,14 +941,14 @@ namespace vks
 			// Create fence to ensure that the command buffer has finished executing
 			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
 			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
+			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, allocationCallbacks, &fence));
 			
 			// Submit to the queue
 			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
 			// Wait for the fence to signal that command buffer has finished executing
 			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 
-			vkDestroyFence(logicalDevice, fence, nullptr);
+			vkDestroyFence(logicalDevice, fence, allocationCallbacks);
 
 			if (free)
 			{
@@ -115,13 +115,13 @@ namespace vks
 			assert(vulkanDevice);
 			for (auto attachment : attachments)
 			{
-				vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
-				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
-				vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
+				vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, vulkanDevice->allocationCallbacks);
+				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, vulkanDevice->allocationCallbacks);
+				vulkanDevice->freeMemory(attachment.memory);
 			}
-			vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
-			vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
-			vkDestroyFramebuffer(vulkanDevice->logicalDevice, framebuffer, nullptr);
+			vkDestroySampler(vulkanDevice->logicalDevice, sampler, vulkanDevice->allocationCallbacks);
+			vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, vulkanDevice->allocationCallbacks);
+			vkDestroyFramebuffer(vulkanDevice->logicalDevice, framebuffer, vulkanDevice->allocationCallbacks);
 		}
 
 		/**
@@ -178,11 +178,11 @@ namespace vks
 			VkMemoryRequirements memReqs;
 
 			// Create image for this attachment
-			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, nullptr, &attachment.image));
+			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, vulkanDevice->allocationCallbacks, &attachment.image));
 			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
 			memAlloc.allocationSize = memReqs.size;
 			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &attachment.memory));
+			VK_CHECK_RESULT(vulkanDevice->allocateMemory(&memAlloc, vks::MEMORY_CATEGORY_FRAMEBUFFER, &attachment.memory));
 			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, attachment.image, attachment.memory, 0));
 
 			attachment.subresourceRange = {};
@@ -197,7 +197,7 @@ namespace vks
 			//todo: workaround for depth+stencil attachments
 			imageView.subresourceRange.aspectMask = (attachment.hasDepth()) ? VK_IMAGE_ASPECT_DEPTH_BIT : aspectMask;
 			imageView.image = attachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageView, nullptr, &attachment.view));
+			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageView, vulkanDevice->allocationCallbacks, &attachment.view));
 
 			// Fill attachment description
 			attachment.description = {};
@@ -248,7 +248,7 @@ namespace vks
 			samplerInfo.minLod = 0.0f;
 			samplerInfo.maxLod = 1.0f;
 			samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			return vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler);
+			return vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, vulkanDevice->allocationCallbacks, &sampler);
 		}
 
 		/**
@@ -331,7 +331,7 @@ namespace vks
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, vulkanDevice->allocationCallbacks, &renderPass));
 
 			std::vector<VkImageView> attachmentViews;
 			for (auto attachment : attachments)
@@ -357,7 +357,7 @@ namespace vks
 			framebufferInfo.width = width;
 			framebufferInfo.height = height;
 			framebufferInfo.layers = maxLayers;
-			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferInfo, nullptr, &framebuffer));
+			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferInfo, vulkanDevice->allocationCallbacks, &framebuffer));
 
 			return VK_SUCCESS;
 		}
@@ -191,64 +191,20 @@ namespace vks
 			vertexBufferSize = (patchsize * patchsize * 4) * sizeof(Vertex);
 
 			// Generate Vulkan buffers
-
-			vks::Buffer vertexStaging, indexStaging;
-
-			// Create staging buffers
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&vertexStaging,
-				vertexBufferSize,
-				vertices);
-
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&indexStaging,
-				indexBufferSize,
-				indices);
-
-			// Device local (target) buffer
-			device->createBuffer(
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			// Written directly if device local memory is host visible, staged otherwise
+			device->createDeviceLocalBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 				&vertexBuffer,
-				vertexBufferSize);
+				vertexBufferSize,
+				vertices,
+				copyQueue);
 
-			device->createBuffer(
-				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			device->createDeviceLocalBuffer(
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 				&indexBuffer,
-				indexBufferSize);
-
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion = {};
-
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				vertexStaging.buffer,
-				vertexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			copyRegion.size = indexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				indexStaging.buffer,
-				indexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+				indexBufferSize,
+				indices,
+				copyQueue);
 		}
 	};
 }
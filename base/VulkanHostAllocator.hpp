@@ -0,0 +1,404 @@
+/*
+* Vulkan host memory allocator
+*
+* Implements VkAllocationCallbacks that track driver host allocations per allocation scope
+* and serve small command and object scope allocations from thread local arenas
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/** @brief Returns a short display name for a host allocation scope */
+	inline const char* allocationScopeName(VkSystemAllocationScope scope)
+	{
+		switch (scope)
+		{
+		case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "Command";
+		case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "Object";
+		case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "Cache";
+		case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "Device";
+		case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "Instance";
+		default: return "Unknown";
+		}
+	}
+
+	/** @brief Point in time copy of the host allocation statistics */
+	struct HostAllocationStatistics
+	{
+		struct Scope
+		{
+			/** @brief Bytes currently allocated through the callbacks */
+			uint64_t allocated = 0;
+			uint64_t peak = 0;
+			/** @brief Number of live allocations */
+			uint64_t allocationCount = 0;
+			/** @brief Number of allocation and reallocation calls since the allocator was created */
+			uint64_t totalAllocations = 0;
+			/** @brief Bytes the driver reported as allocated internally (not served by the callbacks) */
+			uint64_t internalAllocated = 0;
+		} scopes[VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE];
+
+		/** @brief Allocations served from the thread local arenas instead of the system heap */
+		uint64_t arenaAllocations = 0;
+		/** @brief Memory reserved for the thread local arenas */
+		uint64_t arenaSize = 0;
+	};
+
+	/**
+	* @brief Host memory allocator for the Vulkan driver
+	*
+	* Command and object scope allocations up to maxArenaSlotSize are carved from per thread chunks and recycled
+	* through per thread free lists, which avoids the system heap for the high frequency driver allocations
+	* (command buffer recording, descriptor and pipeline objects). All other allocations go to the system heap.
+	*
+	* @note Must outlive all Vulkan objects that have been created with its callbacks
+	*/
+	class HostAllocator
+	{
+	private:
+		/** @brief Stored in front of every allocation */
+		struct Header
+		{
+			uint64_t size;
+			uint32_t scope;
+			/** @brief Arena size class, heapClass for allocations from the system heap */
+			uint16_t sizeClass;
+			/** @brief Distance from the start of the slot (or system allocation) to the user pointer */
+			uint16_t offset;
+		};
+
+		static const uint16_t heapClass = 0xFFFF;
+		static const uint32_t sizeClassCount = 6;
+		static const size_t minArenaSlotSize = 64;
+		static const size_t maxArenaSlotSize = minArenaSlotSize << (sizeClassCount - 1);
+		static const size_t maxArenaAlignment = 64;
+		static const size_t arenaChunkSize = 64 * 1024;
+		/** @brief Number of allocators a thread keeps arenas for at the same time, using another allocator drops the least recently used arena */
+		static const uint32_t threadArenaCount = 4;
+
+		struct ThreadArena
+		{
+			/** @brief Id of the allocator the free lists and the current chunk belong to */
+			uint64_t owner = 0;
+			void* freeLists[sizeClassCount] = {};
+			char* cursor = nullptr;
+			char* end = nullptr;
+		};
+
+		struct ScopeCounters
+		{
+			std::atomic<uint64_t> allocated;
+			std::atomic<uint64_t> peak;
+			std::atomic<uint64_t> allocationCount;
+			std::atomic<uint64_t> totalAllocations;
+			std::atomic<uint64_t> internalAllocated;
+		};
+
+		VkAllocationCallbacks callbacks;
+		uint64_t id;
+		ScopeCounters scopes[VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE];
+		std::atomic<uint64_t> arenaAllocations;
+		std::vector<void*> chunks;
+		std::mutex chunkLock;
+
+		/** @brief Arenas of the calling thread, ordered from most to least recently used */
+		static ThreadArena* threadArenas()
+		{
+			static thread_local ThreadArena arenas[threadArenaCount];
+			return arenas;
+		}
+
+		static uint64_t nextId()
+		{
+			static std::atomic<uint64_t> counter(0);
+			return ++counter;
+		}
+
+		/**
+		* Returns the calling thread's arena for this allocator
+		*
+		* Each thread keeps a small table of arenas keyed by allocator id, so allocators used alternately (e.g. instance and device callbacks) keep their free lists
+		* If the table is full the least recently used arena is reset, its slots are released with the chunks of its allocator
+		*/
+		ThreadArena& getArena()
+		{
+			ThreadArena* arenas = threadArenas();
+			uint32_t index = 0;
+			while ((index < threadArenaCount - 1) && (arenas[index].owner != id))
+			{
+				index++;
+			}
+			if (arenas[index].owner != id)
+			{
+				arenas[index] = ThreadArena();
+				arenas[index].owner = id;
+			}
+			std::rotate(arenas, arenas + index, arenas + index + 1);
+			return arenas[0];
+		}
+
+		static size_t alignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		void account(VkSystemAllocationScope scope, uint64_t size, bool add)
+		{
+			ScopeCounters& counters = scopes[scope];
+			if (add)
+			{
+				uint64_t allocated = counters.allocated.fetch_add(size) + size;
+				counters.allocationCount++;
+				counters.totalAllocations++;
+				uint64_t peak = counters.peak.load();
+				while ((allocated > peak) && !counters.peak.compare_exchange_weak(peak, allocated));
+			}
+			else
+			{
+				counters.allocated -= size;
+				counters.allocationCount--;
+			}
+		}
+
+		/** @brief Allocate a slot from the calling thread's arena, returns nullptr if the request can't be served by the arenas */
+		void* allocateFromArena(size_t size, size_t alignment)
+		{
+			const size_t headerSize = std::max(sizeof(Header), alignment);
+			if ((alignment > maxArenaAlignment) || (size + headerSize > maxArenaSlotSize))
+			{
+				return nullptr;
+			}
+			uint16_t sizeClass = 0;
+			size_t slotSize = minArenaSlotSize;
+			while (slotSize < size + headerSize)
+			{
+				slotSize <<= 1;
+				sizeClass++;
+			}
+
+			ThreadArena& arena = getArena();
+			char* slot = static_cast<char*>(arena.freeLists[sizeClass]);
+			if (slot)
+			{
+				arena.freeLists[sizeClass] = *reinterpret_cast<void**>(slot);
+			}
+			else
+			{
+				if ((arena.cursor == nullptr) || (arena.cursor + slotSize > arena.end))
+				{
+					// Start a new chunk, the rest of the current one is left unused
+					char* chunk = static_cast<char*>(malloc(arenaChunkSize + maxArenaAlignment));
+					if (!chunk)
+					{
+						return nullptr;
+					}
+					{
+						std::lock_guard<std::mutex> guard(chunkLock);
+						chunks.push_back(chunk);
+					}
+					arena.cursor = reinterpret_cast<char*>(alignUp(reinterpret_cast<size_t>(chunk), maxArenaAlignment));
+					arena.end = arena.cursor + arenaChunkSize;
+				}
+				// Slots are multiples of the largest supported alignment, so all slots of a chunk are aligned
+				slot = arena.cursor;
+				arena.cursor += alignUp(slotSize, maxArenaAlignment);
+			}
+
+			char* memory = slot + headerSize;
+			Header* header = reinterpret_cast<Header*>(memory) - 1;
+			header->sizeClass = sizeClass;
+			header->offset = static_cast<uint16_t>(headerSize);
+			arenaAllocations++;
+			return memory;
+		}
+
+		void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			if (size == 0)
+			{
+				return nullptr;
+			}
+			alignment = std::max(alignment, sizeof(void*));
+
+			char* memory = nullptr;
+			if ((scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) || (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+			{
+				memory = static_cast<char*>(allocateFromArena(size, alignment));
+			}
+			if (!memory)
+			{
+				const size_t headerSize = alignUp(sizeof(Header), alignment);
+				char* raw = static_cast<char*>(malloc(size + headerSize + alignment));
+				if (!raw)
+				{
+					return nullptr;
+				}
+				memory = reinterpret_cast<char*>(alignUp(reinterpret_cast<size_t>(raw) + headerSize, alignment));
+				Header* header = reinterpret_cast<Header*>(memory) - 1;
+				header->sizeClass = heapClass;
+				header->offset = static_cast<uint16_t>(memory - raw);
+			}
+
+			Header* header = reinterpret_cast<Header*>(memory) - 1;
+			header->size = size;
+			header->scope = scope;
+			account(scope, size, true);
+			return memory;
+		}
+
+		void free(void* memory)
+		{
+			if (!memory)
+			{
+				return;
+			}
+			Header* header = reinterpret_cast<Header*>(memory) - 1;
+			account(static_cast<VkSystemAllocationScope>(header->scope), header->size, false);
+			char* slot = static_cast<char*>(memory) - header->offset;
+			if (header->sizeClass == heapClass)
+			{
+				::free(slot);
+				return;
+			}
+			// Slots freed on another thread than they were allocated on move to the free list of the freeing thread
+			ThreadArena& arena = getArena();
+			*reinterpret_cast<void**>(slot) = arena.freeLists[header->sizeClass];
+			arena.freeLists[header->sizeClass] = slot;
+		}
+
+		void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+		{
+			if (!original)
+			{
+				return allocate(size, alignment, scope);
+			}
+			if (size == 0)
+			{
+				free(original);
+				return nullptr;
+			}
+			Header* header = reinterpret_cast<Header*>(original) - 1;
+			// Arena slots can grow in place as long as the new size still fits the slot
+			if ((header->sizeClass != heapClass) && (header->scope == static_cast<uint32_t>(scope)) && (size + header->offset <= (minArenaSlotSize << header->sizeClass)) && ((reinterpret_cast<size_t>(original) & (alignment - 1)) == 0))
+			{
+				account(scope, header->size, false);
+				account(scope, size, true);
+				header->size = size;
+				return original;
+			}
+			void* memory = allocate(size, alignment, scope);
+			if (memory)
+			{
+				memcpy(memory, original, std::min(static_cast<size_t>(header->size), size));
+				free(original);
+			}
+			return memory;
+		}
+
+		static VKAPI_ATTR void* VKAPI_CALL allocationFunction(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return static_cast<HostAllocator*>(pUserData)->allocate(size, alignment, allocationScope);
+		}
+
+		static VKAPI_ATTR void* VKAPI_CALL reallocationFunction(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+		{
+			return static_cast<HostAllocator*>(pUserData)->reallocate(pOriginal, size, alignment, allocationScope);
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL freeFunction(void* pUserData, void* pMemory)
+		{
+			static_cast<HostAllocator*>(pUserData)->free(pMemory);
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL internalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope)
+		{
+			static_cast<HostAllocator*>(pUserData)->scopes[allocationScope].internalAllocated += size;
+		}
+
+		static VKAPI_ATTR void VKAPI_CALL internalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType /*allocationType*/, VkSystemAllocationScope allocationScope)
+		{
+			static_cast<HostAllocator*>(pUserData)->scopes[allocationScope].internalAllocated -= size;
+		}
+
+	public:
+		HostAllocator() : id(nextId()), arenaAllocations(0)
+		{
+			for (auto& counters : scopes)
+			{
+				counters.allocated = 0;
+				counters.peak = 0;
+				counters.allocationCount = 0;
+				counters.totalAllocations = 0;
+				counters.internalAllocated = 0;
+			}
+			callbacks.pUserData = this;
+			callbacks.pfnAllocation = allocationFunction;
+			callbacks.pfnReallocation = reallocationFunction;
+			callbacks.pfnFree = freeFunction;
+			callbacks.pfnInternalAllocation = internalAllocationNotification;
+			callbacks.pfnInternalFree = internalFreeNotification;
+		}
+
+		HostAllocator(const HostAllocator&) = delete;
+		HostAllocator& operator=(const HostAllocator&) = delete;
+
+		/**
+		* Release the arena chunks
+		*
+		* @note The arenas of other threads still reference this allocator's id, ids are never reused so these entries are only dropped once they are the least recently used
+		*/
+		~HostAllocator()
+		{
+			ThreadArena* arenas = threadArenas();
+			for (uint32_t i = 0; i < threadArenaCount; i++)
+			{
+				if (arenas[i].owner == id)
+				{
+					arenas[i] = ThreadArena();
+				}
+			}
+			for (auto chunk : chunks)
+			{
+				::free(chunk);
+			}
+		}
+
+		/** @brief Callbacks to pass as pAllocator to the vkCreate* and matching vkDestroy* functions */
+		const VkAllocationCallbacks* getCallbacks() const
+		{
+			return &callbacks;
+		}
+
+		/** @brief Returns a copy of the current statistics (counters are updated lock free and may be slightly out of sync with each other) */
+		HostAllocationStatistics getStatistics()
+		{
+			HostAllocationStatistics stats;
+			for (uint32_t i = 0; i < VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE; i++)
+			{
+				stats.scopes[i].allocated = scopes[i].allocated;
+				stats.scopes[i].peak = scopes[i].peak;
+				stats.scopes[i].allocationCount = scopes[i].allocationCount;
+				stats.scopes[i].totalAllocations = scopes[i].totalAllocations;
+				stats.scopes[i].internalAllocated = scopes[i].internalAllocated;
+			}
+			stats.arenaAllocations = arenaAllocations;
+			std::lock_guard<std::mutex> guard(chunkLock);
+			stats.arenaSize = chunks.size() * arenaChunkSize;
+			return stats;
+		}
+	};
+}
@@ -0,0 +1,449 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates device local resources from larger memory blocks and compacts these blocks over time
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryTracker.hpp"
+
+namespace vks
+{
+	class MemoryAllocator;
+	struct MemoryBlock;
+
+	/**
+	* @brief Device memory range handed out by the MemoryAllocator
+	* @note Resources bound to an allocation must use memory and offset
+	*/
+	struct Allocation
+	{
+		MemoryAllocator *allocator = nullptr;
+		/** @brief Block this allocation lives in, nullptr for dedicated allocations */
+		MemoryBlock *block = nullptr;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		VkDeviceSize alignment = 0;
+		uint32_t memoryTypeIndex = 0;
+		MemoryCategory category = MEMORY_CATEGORY_OTHER;
+
+		/**
+		* @brief Records the copy of the resource into a new resource bound at the passed memory location (set by the resource owner to allow relocation)
+		* @note The copy must leave the new resource in the layout the owner expects, the old resource must stay valid until commit is called
+		*/
+		std::function<void(VkCommandBuffer copyCmd, VkDeviceMemory memory, VkDeviceSize offset)> copy;
+		/** @brief Called once the copy has finished executing, the owner switches to the new resource and releases the old one */
+		std::function<void()> commit;
+		/**
+		* @brief Called instead of commit if a planned move is abandoned, destroys the new resource created by copy
+		* @note Must not access the owner, which may already be gone (e.g. when the device is destroyed with a pending step)
+		*/
+		std::function<void()> discard;
+		/** @brief True while the allocation is part of a planned defragmentation move that has not been committed or discarded yet */
+		bool moving = false;
+
+		/** @brief True if the owner registered the callbacks required to move this allocation */
+		bool relocatable() const { return block && copy && commit && discard; }
+	};
+
+	/** @brief Single device memory allocation that resources are sub-allocated from */
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		VkDeviceSize used = 0;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Linear (buffers) and optimal (images) resources live in separate blocks so bufferImageGranularity never applies */
+		bool linear = true;
+		/** @brief Free ranges of the block (offset -> size), adjacent ranges are always merged */
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		std::vector<Allocation*> allocations;
+
+		/** @brief Find and remove a free range that fits size with the requested alignment, returns false if the block can't hold the range */
+		bool reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+		{
+			for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+			{
+				VkDeviceSize rangeOffset = it->first;
+				VkDeviceSize rangeSize = it->second;
+				VkDeviceSize alignedOffset = (rangeOffset + alignment - 1) / alignment * alignment;
+				if (alignedOffset + size > rangeOffset + rangeSize)
+				{
+					continue;
+				}
+				freeRanges.erase(it);
+				if (alignedOffset > rangeOffset)
+				{
+					freeRanges[rangeOffset] = alignedOffset - rangeOffset;
+				}
+				if (alignedOffset + size < rangeOffset + rangeSize)
+				{
+					freeRanges[alignedOffset + size] = rangeOffset + rangeSize - (alignedOffset + size);
+				}
+				used += size;
+				*offset = alignedOffset;
+				return true;
+			}
+			return false;
+		}
+
+		/** @brief Return a range to the block and merge it with its neighbours */
+		void release(VkDeviceSize offset, VkDeviceSize size)
+		{
+			used -= size;
+			auto next = freeRanges.lower_bound(offset);
+			if (next != freeRanges.end() && offset + size == next->first)
+			{
+				size += next->second;
+				next = freeRanges.erase(next);
+			}
+			if (next != freeRanges.begin())
+			{
+				auto prev = std::prev(next);
+				if (prev->first + prev->second == offset)
+				{
+					prev->second += size;
+					return;
+				}
+			}
+			freeRanges[offset] = size;
+		}
+	};
+
+	/** @brief Result of a defragmentation step */
+	struct DefragmentationStats
+	{
+		VkDeviceSize bytesMoved = 0;
+		uint32_t allocationsMoved = 0;
+		uint32_t blocksFreed = 0;
+	};
+
+	/**
+	* @brief Sub-allocates device local (not host visible) resources from large blocks, all other memory is allocated dedicated
+	* @note Owned by the VulkanDevice, see VulkanDevice::beginDefragmentation for compacting the blocks
+	*/
+	class MemoryAllocator
+	{
+	public:
+		/** @brief A planned relocation of an allocation to a reserved range in another block */
+		struct Move
+		{
+			Allocation *allocation;
+			MemoryBlock *block;
+			VkDeviceSize offset;
+		};
+
+		/** @brief Size of newly created blocks (smaller on small heaps) */
+		VkDeviceSize blockSize = 64 * 1024 * 1024;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vks::MemoryTracker *tracker = nullptr;
+		std::vector<MemoryBlock*> blocks;
+
+		bool subAllocate(uint32_t memoryTypeIndex, VkDeviceSize size)
+		{
+			// Host visible memory is mapped per allocation, so only sub-allocate memory that is never mapped
+			if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				return false;
+			}
+			return size <= blockSizeForType(memoryTypeIndex) / 4;
+		}
+
+		VkDeviceSize blockSizeForType(uint32_t memoryTypeIndex)
+		{
+			VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			return std::min(blockSize, heapSize / 8);
+		}
+
+		MemoryBlock* createBlock(uint32_t memoryTypeIndex, bool linear)
+		{
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = blockSizeForType(memoryTypeIndex);
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			VkDeviceMemory memory;
+			if (tracker->allocateBlock(&memAlloc, &memory) != VK_SUCCESS)
+			{
+				return nullptr;
+			}
+			MemoryBlock *block = new MemoryBlock();
+			block->memory = memory;
+			block->size = memAlloc.allocationSize;
+			block->memoryTypeIndex = memoryTypeIndex;
+			block->linear = linear;
+			block->freeRanges[0] = block->size;
+			blocks.push_back(block);
+			return block;
+		}
+
+		void destroyBlock(MemoryBlock *block)
+		{
+			assert(block->allocations.empty());
+			tracker->free(block->memory);
+			blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+			delete block;
+		}
+
+	public:
+		/**
+		* Setup the allocator for a logical device
+		*
+		* @param device Logical device to allocate memory from
+		* @param memoryProperties Memory types and heaps of the physical device
+		* @param tracker Memory tracker all device memory allocations are accounted with
+		*/
+		void init(VkDevice device, VkPhysicalDeviceMemoryProperties memoryProperties, vks::MemoryTracker *tracker)
+		{
+			this->device = device;
+			this->memoryProperties = memoryProperties;
+			this->tracker = tracker;
+		}
+
+		/** @brief Release all memory blocks (allocations still referencing them become invalid) */
+		void destroy()
+		{
+			for (auto block : blocks)
+			{
+				tracker->free(block->memory);
+				delete block;
+			}
+			blocks.clear();
+		}
+
+		/**
+		* Allocate memory for a resource
+		*
+		* @param memReqs Memory requirements of the resource
+		* @param memoryTypeIndex Memory type to allocate from
+		* @param category Category the allocation is accounted to
+		* @param linear True for buffers and linear images, false for optimal tiled images
+		*
+		* @return Pointer to the allocation (to be released with free), nullptr if the allocation failed
+		*/
+		Allocation* allocate(VkMemoryRequirements memReqs, uint32_t memoryTypeIndex, MemoryCategory category, bool linear)
+		{
+			Allocation *allocation = new Allocation();
+			allocation->allocator = this;
+			allocation->size = memReqs.size;
+			allocation->alignment = memReqs.alignment;
+			allocation->memoryTypeIndex = memoryTypeIndex;
+			allocation->category = category;
+
+			if (subAllocate(memoryTypeIndex, memReqs.size))
+			{
+				for (auto block : blocks)
+				{
+					if ((block->memoryTypeIndex == memoryTypeIndex) && (block->linear == linear) && block->reserve(memReqs.size, memReqs.alignment, &allocation->offset))
+					{
+						allocation->block = block;
+						break;
+					}
+				}
+				if (!allocation->block)
+				{
+					MemoryBlock *block = createBlock(memoryTypeIndex, linear);
+					if (block && block->reserve(memReqs.size, memReqs.alignment, &allocation->offset))
+					{
+						allocation->block = block;
+					}
+				}
+				if (allocation->block)
+				{
+					allocation->memory = allocation->block->memory;
+					allocation->block->allocations.push_back(allocation);
+					tracker->accountSubAllocation(category, allocation->size, true);
+					return allocation;
+				}
+			}
+
+			// Dedicated allocation
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			if (tracker->allocate(&memAlloc, category, &allocation->memory) != VK_SUCCESS)
+			{
+				delete allocation;
+				return nullptr;
+			}
+			return allocation;
+		}
+
+		/** @brief Release an allocation, empty blocks are kept for reuse until the next defragmentation step */
+		void free(Allocation *allocation)
+		{
+			if (!allocation)
+			{
+				return;
+			}
+			// The pending move still references the allocation, finish or abort the defragmentation step first
+			assert(!allocation->moving);
+			if (allocation->block)
+			{
+				MemoryBlock *block = allocation->block;
+				block->release(allocation->offset, allocation->size);
+				block->allocations.erase(std::find(block->allocations.begin(), block->allocations.end(), allocation));
+				tracker->accountSubAllocation(allocation->category, allocation->size, false);
+			}
+			else
+			{
+				tracker->free(allocation->memory);
+			}
+			delete allocation;
+		}
+
+		/**
+		* Plan a defragmentation step
+		*
+		* Tries to empty the least used block of each memory type by moving its allocations into the free space of the other blocks
+		* The target ranges are reserved, the source ranges stay valid until endDefragmentation
+		*
+		* @param maxBytesToMove Upper limit for the number of bytes that may be copied in this step
+		*
+		* @return List of moves whose copy commands need to be recorded and executed before calling endDefragmentation
+		*/
+		std::vector<Move> beginDefragmentation(VkDeviceSize maxBytesToMove)
+		{
+			std::vector<Move> moves;
+			VkDeviceSize bytesToMove = 0;
+
+			for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < memoryProperties.memoryTypeCount; memoryTypeIndex++)
+			{
+				for (bool linear : { true, false })
+				{
+					std::vector<MemoryBlock*> pool;
+					for (auto block : blocks)
+					{
+						if ((block->memoryTypeIndex == memoryTypeIndex) && (block->linear == linear) && (block->used > 0))
+						{
+							pool.push_back(block);
+						}
+					}
+					if (pool.size() < 2)
+					{
+						continue;
+					}
+
+					// Fill the fullest blocks first
+					std::sort(pool.begin(), pool.end(), [](const MemoryBlock *a, const MemoryBlock *b) { return a->used > b->used; });
+
+					// Evacuate the least used block that only contains relocatable allocations
+					MemoryBlock *source = nullptr;
+					for (auto it = pool.rbegin(); it != pool.rend(); ++it)
+					{
+						if (std::all_of((*it)->allocations.begin(), (*it)->allocations.end(), [](const Allocation *a) { return a->relocatable(); }))
+						{
+							source = *it;
+							break;
+						}
+					}
+					if (!source)
+					{
+						continue;
+					}
+
+					std::vector<Allocation*> candidates(source->allocations);
+					std::sort(candidates.begin(), candidates.end(), [](const Allocation *a, const Allocation *b) { return a->size > b->size; });
+					for (auto allocation : candidates)
+					{
+						if (bytesToMove + allocation->size > maxBytesToMove)
+						{
+							return moves;
+						}
+						Move move = { allocation, nullptr, 0 };
+						for (auto target : pool)
+						{
+							if ((target != source) && target->reserve(allocation->size, allocation->alignment, &move.offset))
+							{
+								move.block = target;
+								break;
+							}
+						}
+						if (!move.block)
+						{
+							// Not enough space left in the other blocks, keep what has been planned so far
+							break;
+						}
+						allocation->moving = true;
+						moves.push_back(move);
+						bytesToMove += allocation->size;
+					}
+				}
+			}
+			return moves;
+		}
+
+		/**
+		* Finish a defragmentation step once the copies planned by beginDefragmentation have been executed
+		*
+		* Switches the moved allocations to their new location, releases the old ranges and frees all empty blocks
+		*/
+		DefragmentationStats endDefragmentation(const std::vector<Move> &moves)
+		{
+			DefragmentationStats stats;
+			for (auto &move : moves)
+			{
+				Allocation *allocation = move.allocation;
+				MemoryBlock *source = allocation->block;
+				source->release(allocation->offset, allocation->size);
+				source->allocations.erase(std::find(source->allocations.begin(), source->allocations.end(), allocation));
+				allocation->block = move.block;
+				allocation->memory = move.block->memory;
+				allocation->offset = move.offset;
+				move.block->allocations.push_back(allocation);
+				allocation->moving = false;
+				allocation->commit();
+				stats.bytesMoved += allocation->size;
+				stats.allocationsMoved++;
+			}
+
+			// Fully emptied blocks are given back to the driver
+			std::vector<MemoryBlock*> emptyBlocks;
+			for (auto block : blocks)
+			{
+				if (block->allocations.empty())
+				{
+					emptyBlocks.push_back(block);
+				}
+			}
+			for (auto block : emptyBlocks)
+			{
+				destroyBlock(block);
+				stats.blocksFreed++;
+			}
+			return stats;
+		}
+
+		/**
+		* Abandon a planned defragmentation step, the allocations stay at their current location
+		*
+		* Releases the reserved target ranges and lets the owners destroy the resources created by the copies
+		*
+		* @note The copies must not be executing anymore
+		*/
+		void abortDefragmentation(const std::vector<Move> &moves)
+		{
+			for (auto &move : moves)
+			{
+				Allocation *allocation = move.allocation;
+				move.block->release(move.offset, allocation->size);
+				allocation->moving = false;
+				allocation->discard();
+			}
+		}
+	};
+}
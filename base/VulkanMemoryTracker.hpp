@@ -0,0 +1,338 @@
+/*
+* Vulkan device memory accounting
+*
+* Tracks device memory allocations per heap and per usage category
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+
+// VK_EXT_memory_budget is newer than the bundled Vulkan headers, so declare the parts we need here
+#ifndef VK_EXT_memory_budget
+#define VK_EXT_memory_budget 1
+#define VK_EXT_MEMORY_BUDGET_EXTENSION_NAME "VK_EXT_memory_budget"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT ((VkStructureType)1000237000)
+typedef struct VkPhysicalDeviceMemoryBudgetPropertiesEXT {
+	VkStructureType sType;
+	void* pNext;
+	VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryBudgetPropertiesEXT;
+#endif
+
+namespace vks
+{
+	/** @brief Usage category an allocation is accounted to */
+	typedef enum MemoryCategory
+	{
+		MEMORY_CATEGORY_GEOMETRY = 0,
+		MEMORY_CATEGORY_TEXTURE = 1,
+		MEMORY_CATEGORY_UNIFORM = 2,
+		MEMORY_CATEGORY_STAGING = 3,
+		MEMORY_CATEGORY_FRAMEBUFFER = 4,
+		MEMORY_CATEGORY_OTHER = 5,
+		MEMORY_CATEGORY_COUNT = 6
+	} MemoryCategory;
+
+	/** @brief Returns a short display name for a memory category */
+	inline const char* memoryCategoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MEMORY_CATEGORY_GEOMETRY: return "Geometry";
+		case MEMORY_CATEGORY_TEXTURE: return "Textures";
+		case MEMORY_CATEGORY_UNIFORM: return "Uniforms";
+		case MEMORY_CATEGORY_STAGING: return "Staging";
+		case MEMORY_CATEGORY_FRAMEBUFFER: return "Framebuffers";
+		default: return "Other";
+		}
+	}
+
+	/** @brief Guess the category of a buffer allocation from its usage flags */
+	inline MemoryCategory memoryCategoryFromUsage(VkBufferUsageFlags usageFlags)
+	{
+		if (usageFlags & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT))
+		{
+			return MEMORY_CATEGORY_GEOMETRY;
+		}
+		if (usageFlags & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+		{
+			return MEMORY_CATEGORY_UNIFORM;
+		}
+		if (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+		{
+			return MEMORY_CATEGORY_STAGING;
+		}
+		return MEMORY_CATEGORY_OTHER;
+	}
+
+	/** @brief Point in time copy of the memory statistics of a device */
+	struct MemoryStatistics
+	{
+		struct Heap
+		{
+			/** @brief Total size of the heap as reported by the implementation */
+			VkDeviceSize size = 0;
+			/** @brief Amount of memory the process can use from this heap (heap size if VK_EXT_memory_budget is not available) */
+			VkDeviceSize budget = 0;
+			/** @brief Memory used by the process as reported by VK_EXT_memory_budget (tracked bytes otherwise) */
+			VkDeviceSize usage = 0;
+			/** @brief Bytes allocated through the tracker from this heap */
+			VkDeviceSize allocated = 0;
+			uint32_t allocationCount = 0;
+			VkMemoryHeapFlags flags = 0;
+		} heaps[VK_MAX_MEMORY_HEAPS];
+		uint32_t heapCount = 0;
+
+		struct Category
+		{
+			VkDeviceSize allocated = 0;
+			VkDeviceSize peak = 0;
+			uint32_t allocationCount = 0;
+		} categories[MEMORY_CATEGORY_COUNT];
+
+		/** @brief Device memory blocks resources are sub-allocated from (see vks::MemoryAllocator) */
+		struct Blocks
+		{
+			uint32_t count = 0;
+			/** @brief Total size of all blocks */
+			VkDeviceSize size = 0;
+			/** @brief Bytes sub-allocated from the blocks, the difference to size is free (possibly fragmented) space */
+			VkDeviceSize used = 0;
+		} blocks;
+
+		/** @brief True if budget and usage values come from VK_EXT_memory_budget */
+		bool budgetExtension = false;
+
+		/** @brief Sum of all tracked allocations */
+		VkDeviceSize totalAllocated() const
+		{
+			VkDeviceSize total = 0;
+			for (uint32_t i = 0; i < heapCount; i++)
+			{
+				total += heaps[i].allocated;
+			}
+			return total;
+		}
+	};
+
+	/**
+	* @brief Wraps device memory allocation and keeps per heap and per category statistics
+	* @note Owned by the VulkanDevice, all allocations of the framework should go through it
+	*/
+	class MemoryTracker
+	{
+	private:
+		struct Allocation
+		{
+			VkDeviceSize size;
+			uint32_t heapIndex;
+			MemoryCategory category;
+			/** @brief Blocks are only accounted per heap, their contents are accounted with accountSubAllocation */
+			bool block;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		MemoryStatistics stats;
+		std::mutex lock;
+
+	public:
+		/**
+		* Setup the tracker for a logical device
+		*
+		* @param physicalDevice Physical device the memory properties are read from
+		* @param device Logical device allocations are done on
+		* @param getMemoryProperties2 (Optional) Instance level function pointer, if set and VK_EXT_memory_budget is enabled budgets are read from the driver
+		* @param allocationCallbacks (Optional) Host allocation callbacks passed to vkAllocateMemory and vkFreeMemory
+		*/
+		void init(VkPhysicalDevice physicalDevice, VkDevice device, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			this->physicalDevice = physicalDevice;
+			this->device = device;
+			this->getMemoryProperties2 = getMemoryProperties2;
+			this->allocationCallbacks = allocationCallbacks;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			stats.heapCount = memoryProperties.memoryHeapCount;
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				stats.heaps[i].size = memoryProperties.memoryHeaps[i].size;
+				stats.heaps[i].flags = memoryProperties.memoryHeaps[i].flags;
+			}
+		}
+
+		/**
+		* Allocate device memory and account it to the given category
+		*
+		* @param allocateInfo Allocation info as passed to vkAllocateMemory
+		* @param category Category the allocation is accounted to
+		* @param memory Pointer to the memory handle acquired by the function
+		*
+		* @return VkResult of the vkAllocateMemory call
+		*/
+		VkResult allocate(const VkMemoryAllocateInfo *allocateInfo, MemoryCategory category, VkDeviceMemory *memory)
+		{
+			assert(device);
+			VkResult result = vkAllocateMemory(device, allocateInfo, allocationCallbacks, memory);
+			if (result == VK_SUCCESS)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				Allocation allocation;
+				allocation.size = allocateInfo->allocationSize;
+				allocation.heapIndex = memoryProperties.memoryTypes[allocateInfo->memoryTypeIndex].heapIndex;
+				allocation.category = category;
+				allocation.block = false;
+				allocations[*memory] = allocation;
+				account(allocation, true);
+			}
+			return result;
+		}
+
+		/**
+		* Allocate a device memory block that resources are sub-allocated from
+		*
+		* @note Only accounted to the heap, the sub-allocations are accounted to their categories with accountSubAllocation
+		*/
+		VkResult allocateBlock(const VkMemoryAllocateInfo *allocateInfo, VkDeviceMemory *memory)
+		{
+			assert(device);
+			VkResult result = vkAllocateMemory(device, allocateInfo, allocationCallbacks, memory);
+			if (result == VK_SUCCESS)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				Allocation allocation;
+				allocation.size = allocateInfo->allocationSize;
+				allocation.heapIndex = memoryProperties.memoryTypes[allocateInfo->memoryTypeIndex].heapIndex;
+				allocation.category = MEMORY_CATEGORY_OTHER;
+				allocation.block = true;
+				allocations[*memory] = allocation;
+				account(allocation, true);
+			}
+			return result;
+		}
+
+		/** @brief Add (or remove) a range sub-allocated from a memory block to the statistics of its category */
+		void accountSubAllocation(MemoryCategory category, VkDeviceSize size, bool add)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			MemoryStatistics::Category &stat = stats.categories[category];
+			if (add)
+			{
+				stat.allocated += size;
+				stat.allocationCount++;
+				stat.peak = std::max(stat.peak, stat.allocated);
+				stats.blocks.used += size;
+			}
+			else
+			{
+				stat.allocated -= size;
+				stat.allocationCount--;
+				stats.blocks.used -= size;
+			}
+		}
+
+		/**
+		* Free device memory allocated through this tracker
+		*
+		* @note Memory that has not been allocated by the tracker is freed but not accounted
+		*/
+		void free(VkDeviceMemory memory)
+		{
+			if (memory == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				auto it = allocations.find(memory);
+				if (it != allocations.end())
+				{
+					account(it->second, false);
+					allocations.erase(it);
+				}
+			}
+			vkFreeMemory(device, memory, allocationCallbacks);
+		}
+
+		/**
+		* Take a snapshot of the current statistics
+		*
+		* @note Budget and usage are queried from the driver if VK_EXT_memory_budget is enabled
+		*/
+		MemoryStatistics getStatistics()
+		{
+			MemoryStatistics snapshot;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				snapshot = stats;
+			}
+			for (uint32_t i = 0; i < snapshot.heapCount; i++)
+			{
+				snapshot.heaps[i].budget = snapshot.heaps[i].size;
+				snapshot.heaps[i].usage = snapshot.heaps[i].allocated;
+			}
+			if (getMemoryProperties2)
+			{
+				VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+				budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+				VkPhysicalDeviceMemoryProperties2KHR memoryProperties2{};
+				memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+				memoryProperties2.pNext = &budgetProperties;
+				getMemoryProperties2(physicalDevice, &memoryProperties2);
+				for (uint32_t i = 0; i < snapshot.heapCount; i++)
+				{
+					snapshot.heaps[i].budget = budgetProperties.heapBudget[i];
+					snapshot.heaps[i].usage = budgetProperties.heapUsage[i];
+				}
+				snapshot.budgetExtension = true;
+			}
+			return snapshot;
+		}
+
+	private:
+		void account(const Allocation &allocation, bool add)
+		{
+			MemoryStatistics::Heap &heap = stats.heaps[allocation.heapIndex];
+			if (add)
+			{
+				heap.allocated += allocation.size;
+				heap.allocationCount++;
+			}
+			else
+			{
+				heap.allocated -= allocation.size;
+				heap.allocationCount--;
+			}
+			if (allocation.block)
+			{
+				stats.blocks.count = add ? stats.blocks.count + 1 : stats.blocks.count - 1;
+				stats.blocks.size = add ? stats.blocks.size + allocation.size : stats.blocks.size - allocation.size;
+				return;
+			}
+			MemoryStatistics::Category &category = stats.categories[allocation.category];
+			if (add)
+			{
+				category.allocated += allocation.size;
+				category.allocationCount++;
+				category.peak = std::max(category.peak, category.allocated);
+			}
+			else
+			{
+				category.allocated -= allocation.size;
+				category.allocationCount--;
+			}
+		}
+	};
+}
@@ -134,12 +134,10 @@ namespace vks
 		void destroy()
 		{		
 			assert(device);
-			vkDestroyBuffer(device, vertices.buffer, nullptr);
-			vkFreeMemory(device, vertices.memory, nullptr);
+			vertices.destroy();
 			if (indices.buffer != VK_NULL_HANDLE)
 			{
-				vkDestroyBuffer(device, indices.buffer, nullptr);
-				vkFreeMemory(device, indices.memory, nullptr);
+				indices.destroy();
 			}
 		}
 
@@ -307,59 +305,21 @@ namespace vks
 				uint32_t vBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(float);
 				uint32_t iBufferSize = static_cast<uint32_t>(indexBuffer.size()) * sizeof(uint32_t);
 
-				// Use staging buffer to move vertex and index buffer to device local memory
-				// Create staging buffers
-				vks::Buffer vertexStaging, indexStaging;
-
-				// Vertex buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-					&vertexStaging,
-					vBufferSize,
-					vertexBuffer.data()));
-
-				// Index buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-					&indexStaging,
-					iBufferSize,
-					indexBuffer.data()));
-
-				// Create device local target buffers
-				// Vertex buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				// Move vertex and index buffer to device local memory
+				// Written directly if device local memory is host visible, staged otherwise
+				VK_CHECK_RESULT(device->createDeviceLocalBuffer(
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 					&vertices,
-					vBufferSize));
+					vBufferSize,
+					vertexBuffer.data(),
+					copyQueue));
 
-				// Index buffer
-				VK_CHECK_RESULT(device->createBuffer(
-					VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VK_CHECK_RESULT(device->createDeviceLocalBuffer(
+					VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 					&indices,
-					iBufferSize));
-
-				// Copy from staging buffers
-				VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-				VkBufferCopy copyRegion{};
-
-				copyRegion.size = vertices.size;
-				vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-				copyRegion.size = indices.size;
-				vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-				device->flushCommandBuffer(copyCmd, copyQueue);
-
-				// Destroy staging resources
-				vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-				vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-				vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-				vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+					iBufferSize,
+					indexBuffer.data(),
+					copyQueue));
 
 				return true;
 			}
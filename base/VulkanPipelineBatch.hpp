@@ -0,0 +1,129 @@
+/*
+* Vulkan pipeline batch
+*
+* Collects graphics pipeline create infos and creates the pipelines concurrently on the workers of a thread pool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* Batch of graphics pipelines that are created in parallel
+	*
+	* Pipeline creation is independent for each pipeline and the pipeline cache is internally synchronized, so all pipelines of a batch can be compiled at the same time
+	* @note The create infos and all state they point to must stay valid until build() returns
+	*/
+	class PipelineBatch
+	{
+	public:
+		/** @brief Time it took to create a single pipeline */
+		struct Timing
+		{
+			std::string name;
+			double milliseconds;
+		};
+
+		/** @brief Creation times of the pipelines of the last build, in the order they have been added */
+		std::vector<Timing> timings;
+		/** @brief Wall clock time of the last build in milliseconds */
+		double buildTime = 0.0;
+
+		/**
+		* Add a pipeline to the batch
+		*
+		* @param createInfo Create info of the pipeline (copied, the state it points to is not)
+		* @param pipeline Pointer to the handle that receives the pipeline on build()
+		* @param name (Optional) Name of the pipeline used for the timings
+		*/
+		void add(const VkGraphicsPipelineCreateInfo &createInfo, VkPipeline *pipeline, const std::string &name = "")
+		{
+			Entry entry;
+			entry.createInfo = createInfo;
+			entry.pipeline = pipeline;
+			entry.name = name;
+			entries.push_back(entry);
+		}
+
+		/** @brief Number of pipelines in the batch */
+		size_t size() const
+		{
+			return entries.size();
+		}
+
+		/**
+		* Create all pipelines of the batch and wait for them to finish
+		*
+		* Workers take the next pipeline of the batch once they're done with one, so expensive pipelines don't hold back pipelines queued on the same thread
+		*
+		* @param device Logical device to create the pipelines on
+		* @param pipelineCache Cache shared by all workers (may be VK_NULL_HANDLE)
+		* @param threadPool (Optional) Thread pool to create the pipelines on, if null all pipelines are created on the calling thread
+		* @param allocationCallbacks (Optional) Host allocation callbacks the pipelines are created with, the pipelines have to be destroyed with them
+		*/
+		void build(VkDevice device, VkPipelineCache pipelineCache, ThreadPool *threadPool = nullptr, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			auto buildStart = std::chrono::high_resolution_clock::now();
+
+			std::atomic<size_t> next(0);
+			auto worker = [this, device, pipelineCache, allocationCallbacks, &next]()
+			{
+				size_t index;
+				while ((index = next++) < entries.size())
+				{
+					Entry &entry = entries[index];
+					auto start = std::chrono::high_resolution_clock::now();
+					entry.result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &entry.createInfo, allocationCallbacks, entry.pipeline);
+					entry.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				}
+			};
+
+			size_t threadCount = threadPool ? std::min(threadPool->threads.size(), entries.size()) : 0;
+			if (threadCount > 1)
+			{
+				for (size_t t = 0; t < threadCount; t++)
+				{
+					threadPool->threads[t]->addJob(worker);
+				}
+				threadPool->wait();
+			}
+			else
+			{
+				worker();
+			}
+
+			buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+
+			timings.clear();
+			for (auto& entry : entries)
+			{
+				VK_CHECK_RESULT(entry.result);
+				timings.push_back({ entry.name, entry.milliseconds });
+			}
+			entries.clear();
+		}
+
+	private:
+		struct Entry
+		{
+			VkGraphicsPipelineCreateInfo createInfo;
+			VkPipeline *pipeline;
+			std::string name;
+			VkResult result = VK_NOT_READY;
+			double milliseconds = 0.0;
+		};
+		std::vector<Entry> entries;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+/*
+* Vulkan pipeline cache persistence
+*
+* Stores the data of a pipeline cache on disk and loads it on the next start, so pipelines don't have to be compiled from SPIR-V again
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace vks
+{
+	namespace pipelinecache
+	{
+		/** @brief Header at the start of the data returned by vkGetPipelineCacheData (VK_PIPELINE_CACHE_HEADER_VERSION_ONE) */
+		struct HeaderVersionOne
+		{
+			uint32_t headerSize;
+			uint32_t headerVersion;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		};
+
+		/** @brief Header of the cache file, used to detect truncated or otherwise corrupt files before the data is passed to the driver */
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		const uint32_t fileMagic = 0x4350564B; // "VKPC"
+		const uint32_t fileVersion = 1;
+
+		/** @brief 64 bit FNV-1a hash of the cache data */
+		inline uint64_t hash(const void *data, size_t size)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			uint64_t value = 14695981039346656037ull;
+			for (size_t i = 0; i < size; i++)
+			{
+				value = (value ^ bytes[i]) * 1099511628211ull;
+			}
+			return value;
+		}
+
+		/**
+		* Check if pipeline cache data has been created by the given device and driver
+		*
+		* @param data Pointer to the cache data (as returned by vkGetPipelineCacheData)
+		* @param size Size of the cache data in bytes
+		* @param properties Properties of the physical device the cache is to be used with
+		*
+		* @return True if the header matches the vendor, device and pipeline cache UUID of the device
+		*/
+		inline bool isCompatible(const void *data, size_t size, const VkPhysicalDeviceProperties &properties)
+		{
+			if (size < sizeof(HeaderVersionOne))
+			{
+				return false;
+			}
+			HeaderVersionOne header;
+			memcpy(&header, data, sizeof(header));
+			return (header.headerSize >= sizeof(HeaderVersionOne)) &&
+				(header.headerSize <= size) &&
+				(header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+				(header.vendorID == properties.vendorID) &&
+				(header.deviceID == properties.deviceID) &&
+				(memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+		}
+
+		/**
+		* Load pipeline cache data from a file
+		*
+		* Files that are corrupt or have been written by a different device or driver are deleted
+		*
+		* @param filename Path of the cache file
+		* @param properties Properties of the physical device the cache is to be used with
+		*
+		* @return The cache data to pass to vkCreatePipelineCache, empty if there is no valid cache file
+		*/
+		inline std::vector<char> load(const std::string &filename, const VkPhysicalDeviceProperties &properties)
+		{
+			std::vector<char> data;
+			std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
+			if (!is.is_open())
+			{
+				return data;
+			}
+
+			size_t fileSize = static_cast<size_t>(is.tellg());
+			is.seekg(0, std::ios::beg);
+
+			FileHeader header = {};
+			bool valid = (fileSize >= sizeof(FileHeader)) && is.read(reinterpret_cast<char*>(&header), sizeof(header));
+			valid = valid && (header.magic == fileMagic) && (header.version == fileVersion) && (header.dataSize == fileSize - sizeof(FileHeader));
+			if (valid)
+			{
+				data.resize(static_cast<size_t>(header.dataSize));
+				valid = is.read(data.data(), data.size()) && (hash(data.data(), data.size()) == header.dataHash);
+			}
+			is.close();
+
+			if (!valid || !isCompatible(data.data(), data.size(), properties))
+			{
+				data.clear();
+				remove(filename.c_str());
+			}
+			return data;
+		}
+
+		/**
+		* Write the data of a pipeline cache to a file
+		*
+		* The data is written to a temporary file first that then replaces the cache file, so an interrupted write never leaves a partial cache file behind
+		*
+		* @param device Logical device the cache belongs to
+		* @param cache Pipeline cache to store
+		* @param filename Path of the cache file
+		*
+		* @return True if the cache file has been written
+		*/
+		inline bool save(VkDevice device, VkPipelineCache cache, const std::string &filename)
+		{
+			size_t size = 0;
+			VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, nullptr));
+			if (size == 0)
+			{
+				return false;
+			}
+			std::vector<char> data(size);
+			VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, data.data()));
+			data.resize(size);
+
+			FileHeader header = {};
+			header.magic = fileMagic;
+			header.version = fileVersion;
+			header.dataSize = size;
+			header.dataHash = hash(data.data(), data.size());
+
+			const std::string tempFilename = filename + ".tmp";
+			{
+				std::ofstream os(tempFilename, std::ios::binary | std::ios::out | std::ios::trunc);
+				if (!os.is_open())
+				{
+					return false;
+				}
+				os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				os.write(data.data(), data.size());
+				os.flush();
+				if (!os.good())
+				{
+					os.close();
+					remove(tempFilename.c_str());
+					return false;
+				}
+			}
+
+#if defined(_WIN32)
+			// rename doesn't replace existing files on Windows
+			bool replaced = (MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+#else
+			bool replaced = (rename(tempFilename.c_str(), filename.c_str()) == 0);
+#endif
+			if (!replaced)
+			{
+				remove(tempFilename.c_str());
+			}
+			return replaced;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,555 @@
+/*
+* Vulkan pipeline variants
+*
+* Creates the permutations of a graphics pipeline on first use, shader features are selected with specialization constants
+* Variants can be compiled on a background thread while a fallback variant is used in their place
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanPipelineBatch.hpp"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* Copy of the state of a graphics pipeline create info, including all state the create info points to
+	*
+	* Lets pipelines be created long after the state that was used to describe them has gone out of scope
+	* @note Tessellation state and pNext chains are not copied
+	*/
+	struct PipelineState
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		VkPipelineVertexInputStateCreateInfo vertexInput{};
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		VkPipelineViewportStateCreateInfo viewport{};
+		std::vector<VkViewport> viewports;
+		std::vector<VkRect2D> scissors;
+		VkPipelineRasterizationStateCreateInfo rasterization{};
+		VkPipelineMultisampleStateCreateInfo multisample{};
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		VkPipelineColorBlendStateCreateInfo colorBlend{};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		VkPipelineDynamicStateCreateInfo dynamic{};
+		std::vector<VkDynamicState> dynamicStates;
+		// Specialization constants applied to all stages
+		VkSpecializationInfo specializationInfo{};
+		std::vector<VkSpecializationMapEntry> specializationEntries;
+		std::vector<VkBool32> specializationData;
+		VkGraphicsPipelineCreateInfo createInfo{};
+
+		/** @brief Copy a create info and the state it points to */
+		void copy(const VkGraphicsPipelineCreateInfo &source)
+		{
+			assert(source.pTessellationState == nullptr);
+			assert((source.pMultisampleState == nullptr) || (source.pMultisampleState->pSampleMask == nullptr));
+			createInfo = source;
+			stages.assign(source.pStages, source.pStages + source.stageCount);
+			if (source.pVertexInputState)
+			{
+				vertexInput = *source.pVertexInputState;
+				vertexBindings.assign(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+				vertexAttributes.assign(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+			}
+			if (source.pInputAssemblyState)
+			{
+				inputAssembly = *source.pInputAssemblyState;
+			}
+			if (source.pViewportState)
+			{
+				viewport = *source.pViewportState;
+				if (viewport.pViewports)
+				{
+					viewports.assign(viewport.pViewports, viewport.pViewports + viewport.viewportCount);
+				}
+				if (viewport.pScissors)
+				{
+					scissors.assign(viewport.pScissors, viewport.pScissors + viewport.scissorCount);
+				}
+			}
+			if (source.pRasterizationState)
+			{
+				rasterization = *source.pRasterizationState;
+			}
+			if (source.pMultisampleState)
+			{
+				multisample = *source.pMultisampleState;
+			}
+			if (source.pDepthStencilState)
+			{
+				depthStencil = *source.pDepthStencilState;
+			}
+			if (source.pColorBlendState)
+			{
+				colorBlend = *source.pColorBlendState;
+				blendAttachments.assign(colorBlend.pAttachments, colorBlend.pAttachments + colorBlend.attachmentCount);
+			}
+			if (source.pDynamicState)
+			{
+				dynamic = *source.pDynamicState;
+				dynamicStates.assign(dynamic.pDynamicStates, dynamic.pDynamicStates + dynamic.dynamicStateCount);
+			}
+		}
+
+		/** @brief Point the create info at the state of this copy, must be called again after the copy has been moved or modified */
+		const VkGraphicsPipelineCreateInfo& link()
+		{
+			vertexInput.pVertexBindingDescriptions = vertexBindings.data();
+			vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+			vertexInput.pVertexAttributeDescriptions = vertexAttributes.data();
+			vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+			viewport.pViewports = viewports.empty() ? nullptr : viewports.data();
+			viewport.pScissors = scissors.empty() ? nullptr : scissors.data();
+			colorBlend.pAttachments = blendAttachments.data();
+			colorBlend.attachmentCount = static_cast<uint32_t>(blendAttachments.size());
+			dynamic.pDynamicStates = dynamicStates.data();
+			dynamic.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+			specializationInfo.pMapEntries = specializationEntries.data();
+			specializationInfo.dataSize = specializationData.size() * sizeof(VkBool32);
+			specializationInfo.pData = specializationData.data();
+			for (auto& stage : stages)
+			{
+				stage.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+			}
+
+			createInfo.stageCount = static_cast<uint32_t>(stages.size());
+			createInfo.pStages = stages.data();
+			createInfo.pVertexInputState = createInfo.pVertexInputState ? &vertexInput : nullptr;
+			createInfo.pInputAssemblyState = createInfo.pInputAssemblyState ? &inputAssembly : nullptr;
+			createInfo.pViewportState = createInfo.pViewportState ? &viewport : nullptr;
+			createInfo.pRasterizationState = createInfo.pRasterizationState ? &rasterization : nullptr;
+			createInfo.pMultisampleState = createInfo.pMultisampleState ? &multisample : nullptr;
+			createInfo.pDepthStencilState = createInfo.pDepthStencilState ? &depthStencil : nullptr;
+			createInfo.pColorBlendState = createInfo.pColorBlendState ? &colorBlend : nullptr;
+			createInfo.pDynamicState = createInfo.pDynamicState ? &dynamic : nullptr;
+			return createInfo;
+		}
+	};
+
+	/**
+	* Registry of pipeline variants keyed by program, fixed function state bits and shader feature bits
+	*
+	* A program is a set of shader stages with its base pipeline state, a variant is a program combined with state bits (e.g. wireframe)
+	* and feature bits. Feature bit n is passed to all stages as the boolean specialization constant with constant_id n, so
+	* shaders branch on constants that are resolved at pipeline creation instead of at runtime.
+	* Variants are created on first use. Creating them in the middle of a frame stalls, so variants that are known to be used
+	* can be created up front in parallel with prewarm(), e.g. from the list of variants a previous run has used.
+	*
+	* Alternatively request() returns a fallback variant right away and compiles the requested one on a background thread, the
+	* caller re-records its command buffers with the real variant once pollCompleted() reports that it is ready.
+	*
+	* @note get() and request() are thread safe, so variants can be requested from command buffers recorded on multiple threads
+	*/
+	class PipelineVariants
+	{
+	public:
+		/** @brief Creation counts and times, the time spent creating variants on first use stalled the calling thread */
+		struct Statistics
+		{
+			uint32_t prewarmed = 0;
+			uint32_t createdOnDemand = 0;
+			double onDemandMilliseconds = 0.0;
+			uint32_t compiledInBackground = 0;
+			double backgroundMilliseconds = 0.0;
+			uint32_t fallbacksUsed = 0;
+			uint32_t pending = 0;
+		};
+
+		PipelineVariants() {}
+		PipelineVariants(const PipelineVariants&) = delete;
+		PipelineVariants& operator=(const PipelineVariants&) = delete;
+
+		~PipelineVariants()
+		{
+			stopCompiler();
+		}
+
+		/** @brief Creation times of the pipelines of the last prewarm */
+		std::vector<PipelineBatch::Timing> prewarmTimings;
+		/** @brief Wall clock time of the last prewarm in milliseconds */
+		double prewarmTime = 0.0;
+
+		/**
+		* Pack the description of a variant into a key
+		*
+		* @param program Index of the program returned by addProgram (16 bits)
+		* @param state Fixed function state bits interpreted by the state callback (16 bits)
+		* @param features Shader feature bits passed as specialization constants (32 bits)
+		*/
+		static uint64_t makeKey(uint32_t program, uint32_t state, uint32_t features)
+		{
+			assert((program <= 0xFFFF) && (state <= 0xFFFF));
+			return (static_cast<uint64_t>(program) << 48) | (static_cast<uint64_t>(state) << 32) | features;
+		}
+
+		/**
+		* Set up the registry
+		*
+		* @param device Logical device to create the pipelines on
+		* @param pipelineCache Cache used for all variants (may be VK_NULL_HANDLE)
+		* @param applyState Callback that changes the copied program state for the state bits of a variant
+		* @param allocationCallbacks (Optional) Host allocation callbacks the pipelines are created and destroyed with
+		*/
+		void init(VkDevice device, VkPipelineCache pipelineCache, std::function<void(uint32_t state, PipelineState &pipelineState)> applyState, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			this->device = device;
+			this->allocationCallbacks = allocationCallbacks;
+			this->pipelineCache = pipelineCache;
+			this->applyState = applyState;
+		}
+
+		/**
+		* Add a program the variants are created from
+		*
+		* @param createInfo Base create info of the program, copied with the state it points to
+		* @param featureCount Number of feature bits (specialization constants with the ids 0 to featureCount - 1) the shaders of the program read
+		* @param name Name of the program used for logging
+		*
+		* @return Index of the program to be passed to makeKey
+		*/
+		uint32_t addProgram(const VkGraphicsPipelineCreateInfo &createInfo, uint32_t featureCount, const std::string &name)
+		{
+			assert(featureCount <= 32);
+			std::lock_guard<std::mutex> lock(mutex);
+			Program program;
+			program.state.copy(createInfo);
+			program.featureCount = featureCount;
+			program.name = name;
+			programs.push_back(program);
+			return static_cast<uint32_t>(programs.size() - 1);
+		}
+
+		/**
+		* Get the pipeline of a variant, creating it if it has not been used before
+		*
+		* @param key Variant created with makeKey
+		*/
+		VkPipeline get(uint64_t key)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			// A variant that is being created by another thread or compiled in the background is not created a second time
+			compiled.wait(lock, [&] { return pending.find(key) == pending.end(); });
+			auto variant = pipelines.find(key);
+			if (variant != pipelines.end())
+			{
+				return variant->second;
+			}
+
+			// Mark the variant as pending, so other variants can be looked up and created while this one is compiled
+			pending.insert(key);
+			PipelineState state;
+			buildState(key, state);
+			lock.unlock();
+			auto start = std::chrono::high_resolution_clock::now();
+			VkPipeline pipeline;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &state.link(), allocationCallbacks, &pipeline));
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			lock.lock();
+
+			pipelines[key] = pipeline;
+			usedKeys.push_back(key);
+			pending.erase(key);
+			stats.createdOnDemand++;
+			stats.onDemandMilliseconds += milliseconds;
+			compiled.notify_all();
+			return pipeline;
+		}
+
+		/**
+		* Get the pipeline of a variant without waiting for it to be compiled
+		*
+		* If the variant doesn't exist yet, it is queued for compilation on the background thread and the fallback is returned instead
+		*
+		* @param key Variant created with makeKey
+		* @param fallback Variant used until the requested one is ready, should be a cheap variant that already exists (e.g. prewarmed), created synchronously otherwise
+		*
+		* @return The requested variant if it is ready, the fallback variant otherwise
+		*/
+		VkPipeline request(uint64_t key, uint64_t fallback)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto variant = pipelines.find(key);
+				if (variant != pipelines.end())
+				{
+					return variant->second;
+				}
+				if (key != fallback)
+				{
+					if (pending.insert(key).second)
+					{
+						queue.push_back(key);
+						stats.pending = static_cast<uint32_t>(pending.size());
+						if (!compiler.joinable())
+						{
+							stopping = false;
+							compiler = std::thread(&PipelineVariants::compileQueued, this);
+						}
+						queued.notify_one();
+					}
+					stats.fallbacksUsed++;
+				}
+			}
+			return get(fallback);
+		}
+
+		/**
+		* Check if variants have been compiled in the background since the last call
+		*
+		* @return True if command buffers recorded with fallbacks can now be recorded with the requested variants
+		*/
+		bool pollCompleted()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bool completed = backgroundCompleted;
+			backgroundCompleted = false;
+			return completed;
+		}
+
+		/**
+		* Create variants in parallel before they are used
+		*
+		* @param keys Variants to create, variants that already exist, are being created or belong to unknown programs are skipped
+		* @param threadPool (Optional) Thread pool to create the pipelines on
+		*/
+		void prewarm(const std::vector<uint64_t> &keys, ThreadPool *threadPool = nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<uint64_t> newKeys;
+			std::unordered_set<uint64_t> queued;
+			for (auto key : keys)
+			{
+				if ((programIndex(key) < programs.size()) && (pipelines.find(key) == pipelines.end()) && (pending.find(key) == pending.end()) && queued.insert(key).second)
+				{
+					newKeys.push_back(key);
+				}
+			}
+
+			// The batch only copies the create infos, so the states must stay in place until it has been built
+			std::vector<PipelineState> states(newKeys.size());
+			std::vector<VkPipeline> created(newKeys.size(), VK_NULL_HANDLE);
+			PipelineBatch batch;
+			for (size_t i = 0; i < newKeys.size(); i++)
+			{
+				buildState(newKeys[i], states[i]);
+			}
+			for (size_t i = 0; i < newKeys.size(); i++)
+			{
+				batch.add(states[i].link(), &created[i], getName(newKeys[i]));
+			}
+			batch.build(device, pipelineCache, threadPool, allocationCallbacks);
+
+			for (size_t i = 0; i < newKeys.size(); i++)
+			{
+				pipelines[newKeys[i]] = created[i];
+				usedKeys.push_back(newKeys[i]);
+			}
+			stats.prewarmed += static_cast<uint32_t>(newKeys.size());
+			prewarmTimings = batch.timings;
+			prewarmTime = batch.buildTime;
+		}
+
+		/**
+		* Write the keys of all variants that have been created to a file, so the next run can prewarm them
+		*
+		* @return True if the file has been written
+		*/
+		bool saveList(const std::string &filename)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::ofstream os(filename, std::ios::out | std::ios::trunc);
+			if (!os.is_open())
+			{
+				return false;
+			}
+			for (auto key : usedKeys)
+			{
+				os << std::hex << std::setw(16) << std::setfill('0') << key << "\n";
+			}
+			return os.good();
+		}
+
+		/**
+		* Read a list of variant keys written by saveList
+		*
+		* @return Keys of the list, empty if the file doesn't exist
+		*/
+		static std::vector<uint64_t> loadList(const std::string &filename)
+		{
+			std::vector<uint64_t> keys;
+			std::ifstream is(filename);
+			std::string line;
+			while (std::getline(is, line))
+			{
+				std::stringstream ss(line);
+				uint64_t key;
+				if (ss >> std::hex >> key)
+				{
+					keys.push_back(key);
+				}
+			}
+			return keys;
+		}
+
+		/** @brief Readable name of a variant (program name, state and feature bits) */
+		std::string getName(uint64_t key) const
+		{
+			std::stringstream ss;
+			const uint32_t program = programIndex(key);
+			ss << ((program < programs.size()) ? programs[program].name : "unknown") << " (state 0x" << std::hex << ((key >> 32) & 0xFFFF) << ", features 0x" << (key & 0xFFFFFFFF) << ")";
+			return ss.str();
+		}
+
+		/** @brief Get the creation statistics since the registry has been set up */
+		Statistics getStatistics()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return stats;
+		}
+
+		/** @brief Destroy all variants, variants still queued for background compilation are discarded */
+		void destroy()
+		{
+			stopCompiler();
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& pipeline : pipelines)
+			{
+				vkDestroyPipeline(device, pipeline.second, allocationCallbacks);
+			}
+			pipelines.clear();
+			usedKeys.clear();
+		}
+
+	private:
+		struct Program
+		{
+			PipelineState state;
+			uint32_t featureCount;
+			std::string name;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::function<void(uint32_t state, PipelineState &pipelineState)> applyState;
+		std::mutex mutex;
+		std::vector<Program> programs;
+		std::unordered_map<uint64_t, VkPipeline> pipelines;
+		// Keys of the created variants in the order they have been created
+		std::vector<uint64_t> usedKeys;
+		Statistics stats;
+
+		// Background compilation of requested variants
+		std::thread compiler;
+		std::deque<uint64_t> queue;
+		std::unordered_set<uint64_t> pending;
+		std::condition_variable queued;
+		std::condition_variable compiled;
+		bool stopping = false;
+		bool backgroundCompleted = false;
+
+		/** @brief Worker of the background thread, compiles the queued variants one after another */
+		void compileQueued()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true)
+			{
+				queued.wait(lock, [&] { return stopping || !queue.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+				const uint64_t key = queue.front();
+				queue.pop_front();
+
+				PipelineState state;
+				buildState(key, state);
+				// The registry stays usable while the pipeline is compiled
+				lock.unlock();
+				auto start = std::chrono::high_resolution_clock::now();
+				VkPipeline pipeline;
+				VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &state.link(), allocationCallbacks, &pipeline));
+				double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				lock.lock();
+
+				pipelines[key] = pipeline;
+				usedKeys.push_back(key);
+				pending.erase(key);
+				stats.pending = static_cast<uint32_t>(pending.size());
+				stats.compiledInBackground++;
+				stats.backgroundMilliseconds += milliseconds;
+				backgroundCompleted = true;
+				compiled.notify_all();
+			}
+		}
+
+		/** @brief Stop the background thread, variants that have not been started are dropped */
+		void stopCompiler()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			queued.notify_all();
+			if (compiler.joinable())
+			{
+				compiler.join();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.clear();
+			pending.clear();
+			stats.pending = 0;
+			compiled.notify_all();
+		}
+
+		static uint32_t programIndex(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> 48);
+		}
+
+		/** @brief Copy the state of the variant's program and apply the state and feature bits of the key */
+		void buildState(uint64_t key, PipelineState &state)
+		{
+			const Program &program = programs[programIndex(key)];
+			state = program.state;
+			const uint32_t stateBits = static_cast<uint32_t>((key >> 32) & 0xFFFF);
+			if (stateBits && applyState)
+			{
+				applyState(stateBits, state);
+			}
+			const uint32_t features = static_cast<uint32_t>(key & 0xFFFFFFFF);
+			for (uint32_t i = 0; i < program.featureCount; i++)
+			{
+				VkSpecializationMapEntry entry;
+				entry.constantID = i;
+				entry.offset = i * sizeof(VkBool32);
+				entry.size = sizeof(VkBool32);
+				state.specializationEntries.push_back(entry);
+				state.specializationData.push_back((features & (1u << i)) ? VK_TRUE : VK_FALSE);
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,979 @@
+/*
+* Vulkan render graph
+*
+* Passes declare the resources they read and write, the graph derives the barriers between them, skips passes that don't contribute to the outputs and lets transient images with disjoint lifetimes share memory
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanBarrierBatch.hpp"
+
+namespace vks
+{
+	/** @brief How a pass accesses a resource, selects the pipeline stage, access mask and image layout of the access */
+	typedef enum RenderGraphUsage
+	{
+		RENDER_GRAPH_USAGE_NONE = 0,
+		RENDER_GRAPH_USAGE_COLOR_ATTACHMENT,
+		RENDER_GRAPH_USAGE_DEPTH_STENCIL_ATTACHMENT,
+		RENDER_GRAPH_USAGE_DEPTH_STENCIL_READ,
+		RENDER_GRAPH_USAGE_SAMPLED_FRAGMENT,
+		RENDER_GRAPH_USAGE_SAMPLED_COMPUTE,
+		RENDER_GRAPH_USAGE_STORAGE_READ_COMPUTE,
+		RENDER_GRAPH_USAGE_STORAGE_WRITE_COMPUTE,
+		RENDER_GRAPH_USAGE_UNIFORM_READ,
+		RENDER_GRAPH_USAGE_VERTEX_READ,
+		RENDER_GRAPH_USAGE_INDEX_READ,
+		RENDER_GRAPH_USAGE_INDIRECT_READ,
+		RENDER_GRAPH_USAGE_TRANSFER_SRC,
+		RENDER_GRAPH_USAGE_TRANSFER_DST,
+		RENDER_GRAPH_USAGE_HOST_READ,
+		RENDER_GRAPH_USAGE_PRESENT,
+	} RenderGraphUsage;
+
+	/**
+	* Frame graph of passes that communicate through named images and buffers
+	*
+	* Passes are executed in the order they have been added, compile() then
+	* - removes passes whose results are neither read by a later pass nor part of an output
+	* - creates the transient images and binds those that are never used at the same time to overlapping memory
+	* - derives the barriers between the passes, all barriers required by a pass are recorded as a single barrier batch
+	*
+	* Passes that write attachments are run inside a render pass created by the graph, unless an existing render pass is set with useRenderPass
+	*
+	* @note Imported resources must not be in use by the device when an execution starts (e.g. the frame's fence has been waited for)
+	* @note Transient images are shared by all executions of a compiled graph, command buffers executing the same graph are synchronized against each other
+	*/
+	class RenderGraph
+	{
+	public:
+		/** @brief Transient image owned by the graph */
+		struct ImageDesc
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkExtent2D extent = { 0, 0 };
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			/** @brief Usage flags in addition to those derived from the passes' accesses */
+			VkImageUsageFlags usage = 0;
+		};
+
+		/** @brief Results of the last compile and the barriers recorded by a single execution */
+		struct Statistics
+		{
+			uint32_t passes = 0;
+			uint32_t passesCulled = 0;
+			uint32_t pipelineBarriers = 0;
+			uint32_t imageBarriers = 0;
+			uint32_t memoryBarriers = 0;
+			uint32_t transientImages = 0;
+			/** @brief Size of the memory bound to the transient images */
+			VkDeviceSize transientMemory = 0;
+			/** @brief Memory the transient images would need without aliasing */
+			VkDeviceSize transientMemoryUnaliased = 0;
+		};
+
+		/**
+		* Add a transient image, the graph creates it on compile and it's contents don't survive between executions
+		*
+		* @return Handle of the resource
+		*/
+		uint32_t createImage(const std::string &name, const ImageDesc &desc)
+		{
+			Resource resource;
+			resource.name = name;
+			resource.image = true;
+			resource.transient = true;
+			resource.desc = desc;
+			resource.aspect = aspectMask(desc.format);
+			resources.push_back(resource);
+			return static_cast<uint32_t>(resources.size() - 1);
+		}
+
+		/**
+		* Add an image that is owned by the caller
+		*
+		* @param name Name of the resource
+		* @param image Image handle
+		* @param view View used as a framebuffer attachment (may be VK_NULL_HANDLE if the image isn't an attachment)
+		* @param format Format of the image
+		* @param extent Size of the image
+		* @param initialLayout Layout of the image at the start of the execution (VK_IMAGE_LAYOUT_UNDEFINED discards the contents)
+		*
+		* @return Handle of the resource
+		*/
+		uint32_t importImage(const std::string &name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent, VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			Resource resource;
+			resource.name = name;
+			resource.image = true;
+			resource.handle.image = image;
+			resource.view = view;
+			resource.desc.format = format;
+			resource.desc.extent = extent;
+			resource.aspect = aspectMask(format);
+			resource.initialLayout = initialLayout;
+			resources.push_back(resource);
+			return static_cast<uint32_t>(resources.size() - 1);
+		}
+
+		/**
+		* Add a buffer that is owned by the caller
+		*
+		* @note Buffers are synchronized with global memory barriers, so different ranges of a buffer can be imported as separate resources
+		*
+		* @return Handle of the resource
+		*/
+		uint32_t importBuffer(const std::string &name, VkBuffer buffer)
+		{
+			Resource resource;
+			resource.name = name;
+			resource.handle.buffer = buffer;
+			resources.push_back(resource);
+			return static_cast<uint32_t>(resources.size() - 1);
+		}
+
+		/**
+		* Mark an imported resource as a result of the graph, only passes that contribute to results are executed
+		*
+		* @param resource Imported resource
+		* @param finalUsage How the resource is used after the execution (e.g. presenting or reading on the host), the graph transitions it at the end
+		*/
+		void markOutput(uint32_t resource, RenderGraphUsage finalUsage = RENDER_GRAPH_USAGE_NONE)
+		{
+			assert(!resources[resource].transient);
+			resources[resource].output = true;
+			resources[resource].finalUsage = finalUsage;
+		}
+
+		/**
+		* Add a pass, passes are executed in the order they have been added
+		*
+		* @param name Name of the pass
+		* @param execute Records the commands of the pass, called inside the pass' render pass if it has attachments
+		*
+		* @return Handle of the pass
+		*/
+		uint32_t addPass(const std::string &name, std::function<void(VkCommandBuffer)> execute)
+		{
+			Pass pass;
+			pass.name = name;
+			pass.execute = execute;
+			passes.push_back(pass);
+			return static_cast<uint32_t>(passes.size() - 1);
+		}
+
+		/** @brief Declare a read of a resource by a pass */
+		void read(uint32_t pass, uint32_t resource, RenderGraphUsage usage)
+		{
+			assert(!usageInfo(usage).write);
+			addAccess(pass, resource, usage);
+		}
+
+		/** @brief Declare a write of a resource by a pass (attachments that aren't cleared also read their previous contents) */
+		void write(uint32_t pass, uint32_t resource, RenderGraphUsage usage)
+		{
+			assert(usageInfo(usage).write);
+			addAccess(pass, resource, usage);
+		}
+
+		/** @brief Clear an attachment written by a pass at the start of the pass' render pass */
+		void clear(uint32_t pass, uint32_t resource, VkClearValue value)
+		{
+			for (auto& access : passes[pass].accesses)
+			{
+				if (access.resource == resource)
+				{
+					access.clear = true;
+					access.clearValue = value;
+					return;
+				}
+			}
+			assert(!"Resource is not an attachment of the pass");
+		}
+
+		/**
+		* Run a pass inside an existing render pass instead of one created by the graph
+		*
+		* The render pass transitions the attachments itself, they are expected to be in the layout of their final usage (see markOutput) afterwards
+		*
+		* @param pass Pass to run inside the render pass
+		* @param renderPass Render pass to begin
+		* @param framebuffer Framebuffer to begin the render pass with
+		* @param extent Render area
+		* @param clearValues Clear values of the render pass' attachments
+		* @param contents Contents of the subpass (e.g. secondary command buffers)
+		*/
+		void useRenderPass(uint32_t pass, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent, const std::vector<VkClearValue> &clearValues, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE)
+		{
+			Pass &p = passes[pass];
+			p.renderPass = renderPass;
+			p.framebuffer = framebuffer;
+			p.extent = extent;
+			p.clearValues = clearValues;
+			p.contents = contents;
+			p.externalRenderPass = true;
+		}
+
+		/** @brief Get a transient image created by compile() */
+		VkImage getImage(uint32_t resource)
+		{
+			return resources[resource].handle.image;
+		}
+
+		/** @brief Get the view of a transient or imported image */
+		VkImageView getImageView(uint32_t resource)
+		{
+			return resources[resource].view;
+		}
+
+		/** @brief Check if a pass is executed (passes are culled by compile) */
+		bool isPassActive(uint32_t pass)
+		{
+			return passes[pass].active;
+		}
+
+		/**
+		* Cull the passes, create the transient images and render passes and derive the barriers
+		*
+		* @param device Device used to create the transient images, render passes and framebuffers
+		*/
+		void compile(vks::VulkanDevice *device)
+		{
+			assert(!compiled);
+			this->device = device;
+			stats = {};
+			stats.passes = static_cast<uint32_t>(passes.size());
+
+			cullPasses();
+			computeLifetimes();
+			createTransientImages();
+			for (uint32_t p = 0; p < passes.size(); p++)
+			{
+				if (passes[p].active && !passes[p].externalRenderPass && hasAttachments(passes[p]))
+				{
+					createRenderPass(p);
+				}
+			}
+			deriveBarriers();
+			for (auto& pass : passes)
+			{
+				if (pass.active)
+				{
+					countBarriers(pass.barriers);
+				}
+			}
+			countBarriers(finalBarriers);
+			compiled = true;
+		}
+
+		/** @brief Record all active passes and their barriers */
+		void execute(VkCommandBuffer commandBuffer)
+		{
+			assert(compiled);
+			for (auto& pass : passes)
+			{
+				if (!pass.active)
+				{
+					continue;
+				}
+				pass.barriers.record(commandBuffer);
+				if (pass.renderPass != VK_NULL_HANDLE)
+				{
+					VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+					renderPassBeginInfo.renderPass = pass.renderPass;
+					renderPassBeginInfo.framebuffer = pass.framebuffer;
+					renderPassBeginInfo.renderArea.extent = pass.extent;
+					renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+					renderPassBeginInfo.pClearValues = pass.clearValues.data();
+					vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, pass.contents);
+					pass.execute(commandBuffer);
+					vkCmdEndRenderPass(commandBuffer);
+				}
+				else
+				{
+					pass.execute(commandBuffer);
+				}
+			}
+			finalBarriers.record(commandBuffer);
+		}
+
+		/** @brief Get the statistics of the last compile, the barrier counts are those recorded by each execution */
+		Statistics getStatistics()
+		{
+			return stats;
+		}
+
+		/** @brief Release the Vulkan objects created by the graph and remove all passes and resources */
+		void destroy()
+		{
+			for (auto& pass : passes)
+			{
+				if (!pass.externalRenderPass)
+				{
+					if (pass.framebuffer != VK_NULL_HANDLE)
+					{
+						vkDestroyFramebuffer(device->logicalDevice, pass.framebuffer, device->allocationCallbacks);
+					}
+					if (pass.renderPass != VK_NULL_HANDLE)
+					{
+						vkDestroyRenderPass(device->logicalDevice, pass.renderPass, device->allocationCallbacks);
+					}
+				}
+			}
+			for (auto& resource : resources)
+			{
+				if (resource.transient && (resource.handle.image != VK_NULL_HANDLE))
+				{
+					vkDestroyImageView(device->logicalDevice, resource.view, device->allocationCallbacks);
+					vkDestroyImage(device->logicalDevice, resource.handle.image, device->allocationCallbacks);
+				}
+			}
+			for (auto& memory : transientMemory)
+			{
+				device->freeMemory(memory);
+			}
+			transientMemory.clear();
+			passes.clear();
+			resources.clear();
+			finalBarriers.clear();
+			compiled = false;
+		}
+
+	private:
+		struct UsageInfo
+		{
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			VkImageLayout layout;
+			bool write;
+			bool attachment;
+		};
+
+		struct Access
+		{
+			uint32_t resource;
+			RenderGraphUsage usage;
+			bool clear = false;
+			VkClearValue clearValue = {};
+		};
+
+		struct Pass
+		{
+			std::string name;
+			std::function<void(VkCommandBuffer)> execute;
+			std::vector<Access> accesses;
+			bool active = true;
+			bool externalRenderPass = false;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkExtent2D extent = { 0, 0 };
+			std::vector<VkClearValue> clearValues;
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+			vks::BarrierBatch barriers;
+		};
+
+		/** @brief Synchronization state of a resource while the barriers are derived */
+		struct State
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// Stages and accesses of the last write (or layout transition)
+			VkPipelineStageFlags writeStages = 0;
+			VkAccessFlags writeAccess = 0;
+			// Stages that read the resource since the last write
+			VkPipelineStageFlags readStages = 0;
+			// Stages and accesses the last write has been made visible to
+			VkPipelineStageFlags visibleStages = 0;
+			VkAccessFlags visibleAccess = 0;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			bool image = false;
+			bool transient = false;
+			bool output = false;
+			union
+			{
+				VkImage image;
+				VkBuffer buffer;
+			} handle = {};
+			VkImageView view = VK_NULL_HANDLE;
+			ImageDesc desc;
+			VkImageAspectFlags aspect = 0;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			RenderGraphUsage finalUsage = RENDER_GRAPH_USAGE_NONE;
+			// First and last active pass that accesses the resource
+			uint32_t firstPass = UINT32_MAX;
+			uint32_t lastPass = 0;
+			// Memory range of transient images
+			uint32_t memoryIndex = 0;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			State state;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		std::vector<Pass> passes;
+		std::vector<Resource> resources;
+		std::vector<VkDeviceMemory> transientMemory;
+		vks::BarrierBatch finalBarriers;
+		Statistics stats;
+		bool compiled = false;
+
+		static UsageInfo usageInfo(RenderGraphUsage usage)
+		{
+			switch (usage)
+			{
+			case RENDER_GRAPH_USAGE_COLOR_ATTACHMENT:
+				return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true };
+			case RENDER_GRAPH_USAGE_DEPTH_STENCIL_ATTACHMENT:
+				return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true };
+			case RENDER_GRAPH_USAGE_DEPTH_STENCIL_READ:
+				return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, true };
+			case RENDER_GRAPH_USAGE_SAMPLED_FRAGMENT:
+				return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false };
+			case RENDER_GRAPH_USAGE_SAMPLED_COMPUTE:
+				return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false };
+			case RENDER_GRAPH_USAGE_STORAGE_READ_COMPUTE:
+				return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, false };
+			case RENDER_GRAPH_USAGE_STORAGE_WRITE_COMPUTE:
+				return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+			case RENDER_GRAPH_USAGE_UNIFORM_READ:
+				return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+			case RENDER_GRAPH_USAGE_VERTEX_READ:
+				return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+			case RENDER_GRAPH_USAGE_INDEX_READ:
+				return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+			case RENDER_GRAPH_USAGE_INDIRECT_READ:
+				return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+			case RENDER_GRAPH_USAGE_TRANSFER_SRC:
+				return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false };
+			case RENDER_GRAPH_USAGE_TRANSFER_DST:
+				return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false };
+			case RENDER_GRAPH_USAGE_HOST_READ:
+				return { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, false };
+			case RENDER_GRAPH_USAGE_PRESENT:
+				return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, false };
+			default:
+				return { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+			}
+		}
+
+		static VkImageAspectFlags aspectMask(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+		}
+
+		static VkImageUsageFlags imageUsage(RenderGraphUsage usage)
+		{
+			switch (usage)
+			{
+			case RENDER_GRAPH_USAGE_COLOR_ATTACHMENT: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case RENDER_GRAPH_USAGE_DEPTH_STENCIL_ATTACHMENT:
+			case RENDER_GRAPH_USAGE_DEPTH_STENCIL_READ: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case RENDER_GRAPH_USAGE_SAMPLED_FRAGMENT:
+			case RENDER_GRAPH_USAGE_SAMPLED_COMPUTE: return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case RENDER_GRAPH_USAGE_STORAGE_READ_COMPUTE:
+			case RENDER_GRAPH_USAGE_STORAGE_WRITE_COMPUTE: return VK_IMAGE_USAGE_STORAGE_BIT;
+			case RENDER_GRAPH_USAGE_TRANSFER_SRC: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case RENDER_GRAPH_USAGE_TRANSFER_DST: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			default: return 0;
+			}
+		}
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+		void addAccess(uint32_t pass, uint32_t resource, RenderGraphUsage usage)
+		{
+			assert(!compiled && (pass < passes.size()) && (resource < resources.size()));
+			Access access;
+			access.resource = resource;
+			access.usage = usage;
+			passes[pass].accesses.push_back(access);
+		}
+
+		bool hasAttachments(const Pass &pass)
+		{
+			for (auto& access : pass.accesses)
+			{
+				if (usageInfo(access.usage).attachment)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** @brief Keep only passes that write a resource that is an output or read by a later active pass */
+		void cullPasses()
+		{
+			std::vector<bool> needed(resources.size(), false);
+			for (size_t r = 0; r < resources.size(); r++)
+			{
+				needed[r] = resources[r].output;
+			}
+			for (size_t p = passes.size(); p-- > 0;)
+			{
+				Pass &pass = passes[p];
+				pass.active = false;
+				for (auto& access : pass.accesses)
+				{
+					if (usageInfo(access.usage).write && needed[access.resource])
+					{
+						pass.active = true;
+					}
+				}
+				if (!pass.active)
+				{
+					stats.passesCulled++;
+					continue;
+				}
+				for (auto& access : pass.accesses)
+				{
+					const UsageInfo info = usageInfo(access.usage);
+					// Writes that don't replace the whole contents (attachments that are loaded, storage writes) also depend on earlier writes
+					bool reads = !info.write || (info.access & (VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT));
+					if (info.attachment && access.clear)
+					{
+						reads = false;
+					}
+					if (reads)
+					{
+						needed[access.resource] = true;
+					}
+				}
+			}
+		}
+
+		void computeLifetimes()
+		{
+			for (uint32_t p = 0; p < passes.size(); p++)
+			{
+				if (!passes[p].active)
+				{
+					continue;
+				}
+				for (auto& access : passes[p].accesses)
+				{
+					Resource &resource = resources[access.resource];
+					resource.firstPass = std::min(resource.firstPass, p);
+					resource.lastPass = std::max(resource.lastPass, p);
+				}
+			}
+		}
+
+		static bool lifetimesOverlap(const Resource &a, const Resource &b)
+		{
+			return (a.firstPass <= b.lastPass) && (b.firstPass <= a.lastPass);
+		}
+
+		static bool memoryOverlaps(const Resource &a, const Resource &b)
+		{
+			return (a.memoryIndex == b.memoryIndex) && (a.offset < b.offset + b.size) && (b.offset < a.offset + a.size);
+		}
+
+		/**
+		* Create the transient images used by active passes and place them in memory
+		*
+		* Images are placed from largest to smallest at the lowest offset that doesn't overlap an already placed image of the same memory type with an overlapping lifetime
+		*/
+		void createTransientImages()
+		{
+			std::vector<uint32_t> images;
+			std::vector<VkMemoryRequirements> memReqs(resources.size());
+			std::vector<uint32_t> memoryTypes(resources.size());
+			for (uint32_t r = 0; r < resources.size(); r++)
+			{
+				Resource &resource = resources[r];
+				if (!resource.transient || (resource.firstPass == UINT32_MAX))
+				{
+					continue;
+				}
+				VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+				imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageCreateInfo.format = resource.desc.format;
+				imageCreateInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+				imageCreateInfo.mipLevels = 1;
+				imageCreateInfo.arrayLayers = 1;
+				imageCreateInfo.samples = resource.desc.samples;
+				imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageCreateInfo.usage = resource.desc.usage;
+				imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				for (auto& pass : passes)
+				{
+					for (auto& access : pass.accesses)
+					{
+						if (pass.active && (access.resource == r))
+						{
+							imageCreateInfo.usage |= imageUsage(access.usage);
+						}
+					}
+				}
+				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, device->allocationCallbacks, &resource.handle.image));
+				vkGetImageMemoryRequirements(device->logicalDevice, resource.handle.image, &memReqs[r]);
+				memoryTypes[r] = device->getMemoryType(memReqs[r].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				resource.size = memReqs[r].size;
+				stats.transientMemoryUnaliased += memReqs[r].size;
+				images.push_back(r);
+			}
+			stats.transientImages = static_cast<uint32_t>(images.size());
+			if (images.empty())
+			{
+				return;
+			}
+
+			std::sort(images.begin(), images.end(), [&](uint32_t a, uint32_t b) { return memReqs[a].size > memReqs[b].size; });
+
+			// One allocation per memory type, sized to the end of the highest placed image
+			std::vector<uint32_t> allocationTypes;
+			std::vector<VkDeviceSize> allocationSizes;
+			std::vector<uint32_t> placed;
+			for (auto r : images)
+			{
+				Resource &resource = resources[r];
+				auto type = std::find(allocationTypes.begin(), allocationTypes.end(), memoryTypes[r]);
+				resource.memoryIndex = static_cast<uint32_t>(type - allocationTypes.begin());
+				if (type == allocationTypes.end())
+				{
+					allocationTypes.push_back(memoryTypes[r]);
+					allocationSizes.push_back(0);
+				}
+
+				// Candidate offsets are the start of the memory and the ends of the conflicting images
+				std::vector<uint32_t> conflicts;
+				for (auto other : placed)
+				{
+					if ((resources[other].memoryIndex == resource.memoryIndex) && lifetimesOverlap(resource, resources[other]))
+					{
+						conflicts.push_back(other);
+					}
+				}
+				std::vector<VkDeviceSize> candidates = { 0 };
+				for (auto other : conflicts)
+				{
+					candidates.push_back(alignUp(resources[other].offset + resources[other].size, memReqs[r].alignment));
+				}
+				std::sort(candidates.begin(), candidates.end());
+				for (auto offset : candidates)
+				{
+					resource.offset = offset;
+					bool fits = true;
+					for (auto other : conflicts)
+					{
+						if (memoryOverlaps(resource, resources[other]))
+						{
+							fits = false;
+							break;
+						}
+					}
+					if (fits)
+					{
+						break;
+					}
+				}
+				allocationSizes[resource.memoryIndex] = std::max(allocationSizes[resource.memoryIndex], resource.offset + resource.size);
+				placed.push_back(r);
+			}
+
+			for (size_t i = 0; i < allocationTypes.size(); i++)
+			{
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = allocationSizes[i];
+				memAlloc.memoryTypeIndex = allocationTypes[i];
+				VkDeviceMemory memory;
+				VK_CHECK_RESULT(device->allocateMemory(&memAlloc, vks::MEMORY_CATEGORY_FRAMEBUFFER, &memory));
+				transientMemory.push_back(memory);
+				stats.transientMemory += allocationSizes[i];
+			}
+
+			for (auto r : images)
+			{
+				Resource &resource = resources[r];
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, resource.handle.image, transientMemory[resource.memoryIndex], resource.offset));
+				VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+				viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCreateInfo.format = resource.desc.format;
+				viewCreateInfo.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+				viewCreateInfo.image = resource.handle.image;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, device->allocationCallbacks, &resource.view));
+			}
+		}
+
+		/**
+		* Create the render pass and framebuffer of a pass with attachments
+		*
+		* The graph's barriers transition the attachments, so the render pass keeps them in their attachment layouts
+		*/
+		void createRenderPass(uint32_t p)
+		{
+			Pass &pass = passes[p];
+			std::vector<VkAttachmentDescription> attachmentDescriptions;
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference = {};
+			bool hasDepth = false;
+			std::vector<VkImageView> views;
+			for (auto& access : pass.accesses)
+			{
+				const UsageInfo info = usageInfo(access.usage);
+				if (!info.attachment)
+				{
+					continue;
+				}
+				Resource &resource = resources[access.resource];
+				assert(resource.view != VK_NULL_HANDLE);
+				// Contents that nothing reads afterwards don't need to be loaded or stored
+				const bool firstUse = (resource.firstPass == p) && (resource.transient || (resource.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED));
+				const bool usedLater = (resource.lastPass > p) || resource.output;
+
+				VkAttachmentDescription attachment = {};
+				attachment.format = resource.desc.format;
+				attachment.samples = resource.transient ? resource.desc.samples : VK_SAMPLE_COUNT_1_BIT;
+				attachment.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (firstUse ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD);
+				attachment.storeOp = (info.write && usedLater) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.stencilLoadOp = (resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? attachment.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = (resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) ? attachment.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.initialLayout = info.layout;
+				attachment.finalLayout = info.layout;
+
+				const uint32_t index = static_cast<uint32_t>(attachmentDescriptions.size());
+				if (access.usage == RENDER_GRAPH_USAGE_COLOR_ATTACHMENT)
+				{
+					colorReferences.push_back({ index, info.layout });
+				}
+				else
+				{
+					assert(!hasDepth);
+					depthReference = { index, info.layout };
+					hasDepth = true;
+				}
+				attachmentDescriptions.push_back(attachment);
+				views.push_back(resource.view);
+				pass.clearValues.push_back(access.clearValue);
+				pass.extent = resource.desc.extent;
+			}
+
+			VkSubpassDescription subpass = {};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpass.pColorAttachments = colorReferences.data();
+			subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+			renderPassInfo.pAttachments = attachmentDescriptions.data();
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassInfo, device->allocationCallbacks, &pass.renderPass));
+
+			VkFramebufferCreateInfo framebufferInfo = vks::initializers::framebufferCreateInfo();
+			framebufferInfo.renderPass = pass.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = pass.extent.width;
+			framebufferInfo.height = pass.extent.height;
+			framebufferInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferInfo, device->allocationCallbacks, &pass.framebuffer));
+			pass.contents = VK_SUBPASS_CONTENTS_INLINE;
+		}
+
+		/**
+		* Set the state of the resources at the start of an execution
+		*
+		* Transient images start undefined and have to wait for the last accesses of the images sharing their memory, in this execution or the previous one
+		*/
+		void initStates()
+		{
+			for (auto& resource : resources)
+			{
+				resource.state = State();
+				resource.state.layout = resource.transient ? VK_IMAGE_LAYOUT_UNDEFINED : resource.initialLayout;
+			}
+		}
+
+		void addAliasDependencies(uint32_t r, const std::vector<State> &finalStates, State &state)
+		{
+			const Resource &resource = resources[r];
+			bool previousInExecution = false;
+			for (uint32_t o = 0; o < resources.size(); o++)
+			{
+				const Resource &other = resources[o];
+				if ((o != r) && other.transient && (other.lastPass < resource.firstPass) && memoryOverlaps(resource, other))
+				{
+					state.writeStages |= finalStates[o].writeStages | finalStates[o].readStages;
+					state.writeAccess |= finalStates[o].writeAccess;
+					previousInExecution = true;
+				}
+			}
+			if (!previousInExecution)
+			{
+				// First occupant of the memory in this execution, wait for the last occupants of the previous execution
+				for (uint32_t o = 0; o < resources.size(); o++)
+				{
+					const Resource &other = resources[o];
+					if (other.transient && (other.firstPass != UINT32_MAX) && ((o == r) || memoryOverlaps(resource, other)))
+					{
+						state.writeStages |= finalStates[o].writeStages | finalStates[o].readStages;
+						state.writeAccess |= finalStates[o].writeAccess;
+					}
+				}
+			}
+		}
+
+		/**
+		* Add the barrier an access requires to a batch and update the resource's state
+		*
+		* Reads after reads in the same layout and reads that an earlier barrier already made the last write visible to need no barrier
+		*/
+		void addBarrier(Resource &resource, const UsageInfo &info, vks::BarrierBatch &batch)
+		{
+			State &state = resource.state;
+			const bool layoutChange = resource.image && (info.layout != state.layout);
+			VkPipelineStageFlags srcStages = 0;
+			VkAccessFlags srcAccess = 0;
+			bool barrier = false;
+
+			if (layoutChange || info.write)
+			{
+				// Write after read only needs an execution dependency, write after write also has to make the previous write available
+				srcStages = state.writeStages | state.readStages;
+				srcAccess = state.writeAccess;
+				barrier = layoutChange || (srcStages != 0);
+			}
+			else if ((state.writeStages != 0) && (info.access != 0))
+			{
+				barrier = ((info.access & ~state.visibleAccess) != 0) || ((info.stage & ~state.visibleStages) != 0);
+				srcStages = state.writeStages;
+				srcAccess = state.writeAccess;
+			}
+
+			if (barrier)
+			{
+				if (resource.image)
+				{
+					batch.addImageBarrier(resource.handle.image, { resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }, state.layout, info.layout, srcStages, srcAccess, info.stage, info.access);
+				}
+				else
+				{
+					// Buffers share a single global memory barrier per batch
+					batch.addMemoryBarrier(srcStages, srcAccess, info.stage, info.access);
+				}
+			}
+
+			if (info.write || layoutChange)
+			{
+				// A layout transition is a write that is visible to the access that required it
+				state.writeStages = info.stage;
+				state.writeAccess = info.write ? (info.access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)) : 0;
+				state.readStages = info.write ? 0 : info.stage;
+				state.visibleStages = info.write ? 0 : info.stage;
+				state.visibleAccess = info.write ? 0 : info.access;
+				state.layout = info.layout;
+			}
+			else
+			{
+				state.readStages |= info.stage;
+				if (barrier)
+				{
+					state.visibleStages |= info.stage;
+					state.visibleAccess |= info.access;
+				}
+			}
+		}
+
+		/** @brief Derive the barriers of all active passes and the final transitions of the outputs */
+		void deriveBarriers()
+		{
+			// The final states of a first pass are needed to synchronize aliased images between executions
+			std::vector<State> finalStates(resources.size());
+			for (uint32_t iteration = 0; iteration < 2; iteration++)
+			{
+				initStates();
+				for (uint32_t r = 0; r < resources.size(); r++)
+				{
+					if (resources[r].transient && (resources[r].firstPass != UINT32_MAX))
+					{
+						addAliasDependencies(r, finalStates, resources[r].state);
+					}
+				}
+				for (uint32_t p = 0; p < passes.size(); p++)
+				{
+					Pass &pass = passes[p];
+					pass.barriers.clear();
+					if (!pass.active)
+					{
+						continue;
+					}
+					for (auto& access : pass.accesses)
+					{
+						Resource &resource = resources[access.resource];
+						const UsageInfo info = usageInfo(access.usage);
+						if (pass.externalRenderPass && info.attachment)
+						{
+							// The render pass transitions it's attachments itself
+							resource.state = State();
+							resource.state.layout = (resource.finalUsage != RENDER_GRAPH_USAGE_NONE) ? usageInfo(resource.finalUsage).layout : info.layout;
+							resource.state.writeStages = info.stage;
+							resource.state.writeAccess = info.access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+							continue;
+						}
+						addBarrier(resource, info, pass.barriers);
+					}
+				}
+				finalBarriers.clear();
+				for (auto& resource : resources)
+				{
+					if (resource.output && (resource.finalUsage != RENDER_GRAPH_USAGE_NONE))
+					{
+						addBarrier(resource, usageInfo(resource.finalUsage), finalBarriers);
+					}
+				}
+				for (uint32_t r = 0; r < resources.size(); r++)
+				{
+					finalStates[r] = resources[r].state;
+				}
+				if (stats.transientImages == 0)
+				{
+					break;
+				}
+			}
+		}
+
+		void countBarriers(const vks::BarrierBatch &batch)
+		{
+			if (!batch.empty())
+			{
+				stats.pipelineBarriers++;
+				stats.memoryBarriers += batch.memoryBarrierCount();
+				stats.imageBarriers += batch.imageBarrierCount();
+			}
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+/*
+* Vulkan render queue
+*
+* Collects draws with 64 bit sort keys, sorts them to group equal state and records them while skipping redundant binds
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* Render queue that sorts draws by a 64 bit key and records them with a minimal number of state changes
+	*
+	* Key layout (most significant bits first): pass (4 bits), pipeline (12 bits), descriptor set (16 bits), mesh (16 bits), depth bucket (16 bits)
+	* Pipelines, descriptor sets and meshes are registered with the queue and referenced by their index in the key
+	*
+	* @note All pipelines recorded by one queue must use the same pipeline layout, so bound descriptor sets stay valid across pipeline changes
+	*/
+	class RenderQueue
+	{
+	public:
+		/** @brief Max. number of dynamic offsets a draw can pass with it's descriptor set */
+		static const uint32_t maxDynamicOffsets = 4;
+		/** @brief Max. size of the push constants of a draw (min. maxPushConstantsSize guaranteed by the spec) */
+		static const uint32_t maxPushConstantsSize = 128;
+
+		/** @brief Vertex and index buffer of a mesh */
+		struct Mesh
+		{
+			VkBuffer vertexBuffer;
+			VkBuffer indexBuffer;
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		};
+
+		/** @brief Parameters of a single indexed draw */
+		struct DrawCommand
+		{
+			uint32_t indexCount;
+			uint32_t instanceCount = 1;
+			uint32_t firstIndex = 0;
+			int32_t vertexOffset = 0;
+			uint32_t firstInstance = 0;
+			/** @brief Dynamic offsets passed when binding the descriptor set of the draw */
+			uint32_t dynamicOffsetCount = 0;
+			uint32_t dynamicOffsets[maxDynamicOffsets];
+			/** @brief Push constants updated before the draw (starting at offset 0), used for small per draw data that would otherwise require a descriptor set bind */
+			VkShaderStageFlags pushConstantStages = 0;
+			uint32_t pushConstantsSize = 0;
+			uint8_t pushConstants[maxPushConstantsSize];
+		};
+
+		/** @brief Number of draws and state changes recorded, and of the binds that were skipped because the state was already bound */
+		struct Statistics
+		{
+			uint32_t draws = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t pipelineBindsSkipped = 0;
+			uint32_t descriptorSetBinds = 0;
+			uint32_t descriptorSetBindsSkipped = 0;
+			uint32_t vertexBufferBinds = 0;
+			uint32_t vertexBufferBindsSkipped = 0;
+			uint32_t pushConstantUpdates = 0;
+
+			void add(const Statistics &other)
+			{
+				draws += other.draws;
+				pipelineBinds += other.pipelineBinds;
+				pipelineBindsSkipped += other.pipelineBindsSkipped;
+				descriptorSetBinds += other.descriptorSetBinds;
+				descriptorSetBindsSkipped += other.descriptorSetBindsSkipped;
+				vertexBufferBinds += other.vertexBufferBinds;
+				vertexBufferBindsSkipped += other.vertexBufferBindsSkipped;
+				pushConstantUpdates += other.pushConstantUpdates;
+			}
+		};
+
+		/** @brief Register a pipeline and return the index to use in sort keys */
+		uint32_t registerPipeline(VkPipeline pipeline)
+		{
+			assert(pipelines.size() < (1u << pipelineBits));
+			pipelines.push_back(pipeline);
+			return static_cast<uint32_t>(pipelines.size() - 1);
+		}
+
+		/** @brief Register a descriptor set and return the index to use in sort keys */
+		uint32_t registerDescriptorSet(VkDescriptorSet descriptorSet)
+		{
+			assert(descriptorSets.size() < (1u << descriptorSetBits));
+			descriptorSets.push_back(descriptorSet);
+			return static_cast<uint32_t>(descriptorSets.size() - 1);
+		}
+
+		/** @brief Register a mesh and return the index to use in sort keys */
+		uint32_t registerMesh(const Mesh &mesh)
+		{
+			assert(meshes.size() < (1u << meshBits));
+			meshes.push_back(mesh);
+			return static_cast<uint32_t>(meshes.size() - 1);
+		}
+
+		/**
+		* Build a sort key from it's components (excess bits are masked off)
+		*
+		* @param pass Render pass or layer the draw belongs to, sorted first
+		* @param pipeline Index of a registered pipeline
+		* @param descriptorSet Index of a registered descriptor set
+		* @param mesh Index of a registered mesh
+		* @param depthBucket Quantized depth (e.g. front to back for opaque draws), sorted last
+		*/
+		static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, uint32_t depthBucket)
+		{
+			uint64_t key = pass & ((1u << passBits) - 1);
+			key = (key << pipelineBits) | (pipeline & ((1u << pipelineBits) - 1));
+			key = (key << descriptorSetBits) | (descriptorSet & ((1u << descriptorSetBits) - 1));
+			key = (key << meshBits) | (mesh & ((1u << meshBits) - 1));
+			key = (key << depthBits) | (depthBucket & ((1u << depthBits) - 1));
+			return key;
+		}
+
+		/** @brief Add a draw to the queue */
+		void submit(uint64_t key, const DrawCommand &draw)
+		{
+			assert(draw.dynamicOffsetCount <= maxDynamicOffsets);
+			assert(draw.pushConstantsSize <= maxPushConstantsSize);
+			keys.push_back(key);
+			order.push_back(static_cast<uint32_t>(draws.size()));
+			draws.push_back(draw);
+		}
+
+		/** @brief Number of draws in the queue */
+		size_t size() const
+		{
+			return draws.size();
+		}
+
+		/**
+		* Sort the draws by their keys using a stable LSD radix sort over the key bytes
+		*
+		* Bytes that are equal for all keys (e.g. unused key components) are skipped
+		*/
+		void sort()
+		{
+			const size_t count = keys.size();
+			if (count < 2)
+			{
+				return;
+			}
+
+			// Histograms of all eight key bytes in a single pass
+			std::vector<uint32_t> histograms(8 * 256, 0);
+			for (size_t i = 0; i < count; i++)
+			{
+				for (uint32_t b = 0; b < 8; b++)
+				{
+					histograms[b * 256 + ((keys[i] >> (b * 8)) & 0xFF)]++;
+				}
+			}
+
+			sortKeys.resize(count);
+			sortOrder.resize(count);
+			for (uint32_t b = 0; b < 8; b++)
+			{
+				uint32_t *histogram = &histograms[b * 256];
+				// All keys share this byte, the pass wouldn't change the order
+				if (histogram[(keys[0] >> (b * 8)) & 0xFF] == count)
+				{
+					continue;
+				}
+				// Exclusive prefix sum gives the first output position of each bucket
+				uint32_t offset = 0;
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t bucketCount = histogram[i];
+					histogram[i] = offset;
+					offset += bucketCount;
+				}
+				for (size_t i = 0; i < count; i++)
+				{
+					uint32_t position = histogram[(keys[i] >> (b * 8)) & 0xFF]++;
+					sortKeys[position] = keys[i];
+					sortOrder[position] = order[i];
+				}
+				keys.swap(sortKeys);
+				order.swap(sortOrder);
+			}
+		}
+
+		/**
+		* Record the sorted draws in [first, last) into a command buffer
+		*
+		* Pipelines, descriptor sets (with their dynamic offsets) and vertex/index buffers are only bound if they differ from the previous draw
+		* Push constants are updated for every draw that has them
+		* Ranges can be recorded into different command buffers in parallel, as recording doesn't modify the queue
+		*
+		* @param commandBuffer Command buffer to record to (nothing is assumed to be bound at the start)
+		* @param pipelineLayout Pipeline layout shared by all pipelines of the queue
+		* @param first Index of the first sorted draw to record
+		* @param last Index after the last sorted draw to record
+		* @param stats (Optional) Receives the number of recorded draws and binds
+		*/
+		void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, size_t first, size_t last, Statistics *stats = nullptr) const
+		{
+			assert(last <= keys.size());
+			Statistics recordStats;
+
+			uint32_t boundPipeline = invalidIndex;
+			uint32_t boundDescriptorSet = invalidIndex;
+			uint32_t boundMesh = invalidIndex;
+			uint32_t boundOffsetCount = 0;
+			uint32_t boundOffsets[maxDynamicOffsets];
+
+			for (size_t i = first; i < last; i++)
+			{
+				const uint64_t key = keys[i];
+				const DrawCommand &draw = draws[order[i]];
+				const uint32_t pipeline = static_cast<uint32_t>(key >> (depthBits + meshBits + descriptorSetBits)) & ((1u << pipelineBits) - 1);
+				const uint32_t descriptorSet = static_cast<uint32_t>(key >> (depthBits + meshBits)) & ((1u << descriptorSetBits) - 1);
+				const uint32_t mesh = static_cast<uint32_t>(key >> depthBits) & ((1u << meshBits) - 1);
+
+				if (pipeline != boundPipeline)
+				{
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[pipeline]);
+					boundPipeline = pipeline;
+					recordStats.pipelineBinds++;
+				}
+				else
+				{
+					recordStats.pipelineBindsSkipped++;
+				}
+
+				if ((descriptorSet != boundDescriptorSet) ||
+					(draw.dynamicOffsetCount != boundOffsetCount) ||
+					(memcmp(draw.dynamicOffsets, boundOffsets, draw.dynamicOffsetCount * sizeof(uint32_t)) != 0))
+				{
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[descriptorSet], draw.dynamicOffsetCount, draw.dynamicOffsets);
+					boundDescriptorSet = descriptorSet;
+					boundOffsetCount = draw.dynamicOffsetCount;
+					memcpy(boundOffsets, draw.dynamicOffsets, draw.dynamicOffsetCount * sizeof(uint32_t));
+					recordStats.descriptorSetBinds++;
+				}
+				else
+				{
+					recordStats.descriptorSetBindsSkipped++;
+				}
+
+				if (mesh != boundMesh)
+				{
+					VkDeviceSize offsets[1] = { 0 };
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &meshes[mesh].vertexBuffer, offsets);
+					vkCmdBindIndexBuffer(commandBuffer, meshes[mesh].indexBuffer, 0, meshes[mesh].indexType);
+					boundMesh = mesh;
+					recordStats.vertexBufferBinds++;
+				}
+				else
+				{
+					recordStats.vertexBufferBindsSkipped++;
+				}
+
+				if (draw.pushConstantsSize > 0)
+				{
+					vkCmdPushConstants(commandBuffer, pipelineLayout, draw.pushConstantStages, 0, draw.pushConstantsSize, draw.pushConstants);
+					recordStats.pushConstantUpdates++;
+				}
+
+				vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+				recordStats.draws++;
+			}
+
+			if (stats)
+			{
+				*stats = recordStats;
+			}
+		}
+
+		/** @brief Remove all draws, registered state is kept */
+		void clear()
+		{
+			keys.clear();
+			order.clear();
+			draws.clear();
+		}
+
+		/** @brief Remove all draws and registered state (e.g. after handles have changed) */
+		void reset()
+		{
+			clear();
+			pipelines.clear();
+			descriptorSets.clear();
+			meshes.clear();
+		}
+
+	private:
+		static const uint32_t passBits = 4;
+		static const uint32_t pipelineBits = 12;
+		static const uint32_t descriptorSetBits = 16;
+		static const uint32_t meshBits = 16;
+		static const uint32_t depthBits = 16;
+		static const uint32_t invalidIndex = ~0u;
+
+		std::vector<VkPipeline> pipelines;
+		std::vector<VkDescriptorSet> descriptorSets;
+		std::vector<Mesh> meshes;
+
+		/** @brief Sort keys and the index of the draw they belong to, sorted by sort() */
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> order;
+		std::vector<DrawCommand> draws;
+		/** @brief Scratch buffers of the radix sort */
+		std::vector<uint64_t> sortKeys;
+		std::vector<uint32_t> sortOrder;
+	};
+}
\ No newline at end of file
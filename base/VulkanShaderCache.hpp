@@ -0,0 +1,275 @@
+/*
+* Vulkan shader module cache
+*
+* Creates shader modules from memory mapped SPIR-V files and returns existing modules for files that have already been loaded
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <iostream>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	/** @brief Read-only memory mapping of a whole file */
+	class MappedFile
+	{
+	public:
+		const void *data = nullptr;
+		size_t size = 0;
+
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		/**
+		* Map a file into memory
+		*
+		* @param filename Path of the file to map
+		*
+		* @return True if the file has been mapped (empty files can't be mapped)
+		*/
+		bool open(const std::string &filename)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0))
+			{
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+			{
+				close();
+				return false;
+			}
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			size = static_cast<size_t>(fileSize.QuadPart);
+#else
+			file = ::open(filename.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0))
+			{
+				close();
+				return false;
+			}
+			void *mapped = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			data = (mapped != MAP_FAILED) ? mapped : nullptr;
+			size = static_cast<size_t>(fileStat.st_size);
+#endif
+			if (data == nullptr)
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		/** @brief Unmap the file */
+		void close()
+		{
+#if defined(_WIN32)
+			if (data)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mapping)
+			{
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (data)
+			{
+				munmap(const_cast<void*>(data), size);
+			}
+			if (file >= 0)
+			{
+				::close(file);
+				file = -1;
+			}
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+	private:
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
+	};
+
+	/**
+	* Cache of shader modules keyed by file path and SPIR-V content hash
+	*
+	* Loading a path that has been loaded before returns the existing module without touching the file
+	* Different files with the same SPIR-V share a single module
+	* Modules are only required for pipeline creation, so they can be released once all pipelines have been created
+	*
+	* @note Thread safe, so shaders can be loaded from multiple threads
+	*/
+	class ShaderModuleCache
+	{
+	public:
+		/** @brief Number of loads that returned an existing module, and of modules that had to be created */
+		struct Statistics
+		{
+			uint32_t pathHits = 0;
+			uint32_t contentHits = 0;
+			uint32_t modulesCreated = 0;
+			size_t bytesMapped = 0;
+		};
+
+		/**
+		* Set the device modules are created on (must be called before the first load)
+		*
+		* @param device Logical device to create the modules on
+		* @param allocationCallbacks (Optional) Host allocation callbacks the modules are created and destroyed with
+		*/
+		void setDevice(VkDevice device, const VkAllocationCallbacks *allocationCallbacks = nullptr)
+		{
+			this->device = device;
+			this->allocationCallbacks = allocationCallbacks;
+		}
+
+		/**
+		* Get the shader module for a SPIR-V file, creating it if the file hasn't been loaded before
+		*
+		* @param filename Path of the SPIR-V file
+		*
+		* @return Shader module or VK_NULL_HANDLE if the file could not be loaded
+		*/
+		VkShaderModule load(const std::string &filename)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			assert(device != VK_NULL_HANDLE);
+
+			auto path = paths.find(filename);
+			if (path != paths.end())
+			{
+				stats.pathHits++;
+				return modules[path->second];
+			}
+
+			MappedFile file;
+			if (!file.open(filename))
+			{
+				std::cerr << "Error: Could not open shader file \"" << filename << "\"" << std::endl;
+				return VK_NULL_HANDLE;
+			}
+			stats.bytesMapped += file.size;
+
+			const uint64_t hash = hashCode(file.data, file.size);
+			paths[filename] = hash;
+			auto module = modules.find(hash);
+			if (module != modules.end())
+			{
+				stats.contentHits++;
+				return module->second;
+			}
+
+			// Mapped files start at a page boundary, so the code is properly aligned for the uint32_t pointer
+			VkShaderModuleCreateInfo moduleCreateInfo{};
+			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleCreateInfo.codeSize = file.size;
+			moduleCreateInfo.pCode = static_cast<const uint32_t*>(file.data);
+
+			VkShaderModule shaderModule;
+			VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, allocationCallbacks, &shaderModule));
+			modules[hash] = shaderModule;
+			stats.modulesCreated++;
+			return shaderModule;
+		}
+
+		/**
+		* Destroy all modules of the cache
+		*
+		* @note Pipelines that have already been created stay valid, stages referencing the modules can't be used to create new pipelines
+		*/
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& module : modules)
+			{
+				vkDestroyShaderModule(device, module.second, allocationCallbacks);
+			}
+			modules.clear();
+			paths.clear();
+		}
+
+		/** @brief Get the load statistics since the cache has been created */
+		Statistics getStatistics()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return stats;
+		}
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks *allocationCallbacks = nullptr;
+		std::mutex mutex;
+		// File path to content hash
+		std::unordered_map<std::string, uint64_t> paths;
+		// Content hash to shader module
+		std::unordered_map<uint64_t, VkShaderModule> modules;
+		Statistics stats;
+
+		/** @brief 64 bit FNV-1a hash, processes the SPIR-V words to keep up with the file mapping */
+		static uint64_t hashCode(const void *data, size_t size)
+		{
+			uint64_t value = 14695981039346656037ull;
+			const uint32_t *words = static_cast<const uint32_t*>(data);
+			for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+			{
+				value = (value ^ words[i]) * 1099511628211ull;
+			}
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = size & ~(sizeof(uint32_t) - 1); i < size; i++)
+			{
+				value = (value ^ bytes[i]) * 1099511628211ull;
+			}
+			// Files of different length with the same words must not collide
+			return (value ^ size) * 1099511628211ull;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,565 @@
+/*
+* Vulkan SPIR-V reflection
+*
+* Reads the descriptor bindings and push constant blocks of SPIR-V shaders to create descriptor set layouts, pipeline layouts and descriptor pool sizes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkan/spirv.hpp"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanShaderCache.hpp"
+
+namespace vks
+{
+	/**
+	* Collects the resource interface of all shaders that share a pipeline layout
+	*
+	* Bindings used by multiple shaders are merged, their stage flags are combined
+	* SPIR-V has no notion of dynamic descriptors, buffers bound with dynamic offsets have to be marked with setDynamic()
+	*/
+	class ShaderReflection
+	{
+	public:
+		/** @brief Descriptor binding used by at least one of the shaders */
+		struct Binding
+		{
+			uint32_t set;
+			uint32_t binding;
+			VkDescriptorType type;
+			/** @brief Number of descriptors (array size), 0 for runtime sized arrays until set with setDescriptorCount() */
+			uint32_t count;
+			VkShaderStageFlags stages;
+		};
+
+		/**
+		* Add the resources of a SPIR-V module
+		*
+		* @param code Pointer to the SPIR-V words
+		* @param size Size of the code in bytes
+		*
+		* @return False if the code is not a valid SPIR-V module
+		*/
+		bool addShader(const uint32_t *code, size_t size)
+		{
+			const size_t wordCount = size / sizeof(uint32_t);
+			if ((wordCount < 5) || (code[0] != spv::MagicNumber))
+			{
+				return false;
+			}
+			const uint32_t idBound = code[3];
+			std::vector<Id> ids(idBound);
+			VkShaderStageFlags stages = 0;
+
+			// Gather types, variables and decorations
+			size_t offset = 5;
+			while (offset < wordCount)
+			{
+				const uint32_t opcode = code[offset] & spv::OpCodeMask;
+				const uint32_t length = code[offset] >> spv::WordCountShift;
+				if ((length == 0) || (offset + length > wordCount))
+				{
+					return false;
+				}
+				const uint32_t *operands = &code[offset + 1];
+				// The id an instruction defines or decorates must be within the bound declared in the header
+				const uint32_t idOperand = getIdOperand(opcode);
+				if ((idOperand != UINT32_MAX) && ((length <= idOperand + 1) || (operands[idOperand] >= idBound)))
+				{
+					return false;
+				}
+				switch (opcode)
+				{
+				case spv::OpEntryPoint:
+					stages |= getStage(operands[0]);
+					break;
+				case spv::OpDecorate:
+				{
+					Id &id = ids[operands[0]];
+					switch (operands[1])
+					{
+					case spv::DecorationDescriptorSet:
+						id.set = operands[2];
+						break;
+					case spv::DecorationBinding:
+						id.binding = operands[2];
+						break;
+					case spv::DecorationBufferBlock:
+						id.bufferBlock = true;
+						break;
+					case spv::DecorationArrayStride:
+						id.arrayStride = operands[2];
+						break;
+					}
+					break;
+				}
+				case spv::OpMemberDecorate:
+				{
+					Id &id = ids[operands[0]];
+					const uint32_t member = operands[1];
+					if (id.memberOffsets.size() <= member)
+					{
+						id.memberOffsets.resize(member + 1, 0);
+						id.memberMatrixStrides.resize(member + 1, 0);
+					}
+					if (operands[2] == spv::DecorationOffset)
+					{
+						id.memberOffsets[member] = operands[3];
+					}
+					if (operands[2] == spv::DecorationMatrixStride)
+					{
+						id.memberMatrixStrides[member] = operands[3];
+					}
+					break;
+				}
+				case spv::OpTypeInt:
+				case spv::OpTypeFloat:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].width = operands[1];
+					break;
+				case spv::OpTypeVector:
+				case spv::OpTypeMatrix:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].typeId = operands[1];
+					ids[operands[0]].count = operands[2];
+					break;
+				case spv::OpTypeImage:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].dim = operands[2];
+					ids[operands[0]].sampled = operands[6];
+					break;
+				case spv::OpTypeSampler:
+					ids[operands[0]].opcode = opcode;
+					break;
+				case spv::OpTypeSampledImage:
+				case spv::OpTypeRuntimeArray:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].typeId = operands[1];
+					break;
+				case spv::OpTypeArray:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].typeId = operands[1];
+					ids[operands[0]].lengthId = operands[2];
+					break;
+				case spv::OpTypeStruct:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].members.assign(operands + 1, operands + length - 1);
+					break;
+				case spv::OpTypePointer:
+					ids[operands[0]].opcode = opcode;
+					ids[operands[0]].storageClass = operands[1];
+					ids[operands[0]].typeId = operands[2];
+					break;
+				case spv::OpConstant:
+					ids[operands[1]].opcode = opcode;
+					ids[operands[1]].value = operands[2];
+					break;
+				case spv::OpVariable:
+					ids[operands[1]].opcode = opcode;
+					ids[operands[1]].typeId = operands[0];
+					ids[operands[1]].storageClass = operands[2];
+					break;
+				}
+				offset += length;
+			}
+
+			// Turn the resource variables into bindings and push constant ranges
+			for (auto& variable : ids)
+			{
+				if (variable.opcode != spv::OpVariable)
+				{
+					continue;
+				}
+				const Id &pointer = ids[variable.typeId];
+				uint32_t typeId = pointer.typeId;
+
+				if (variable.storageClass == spv::StorageClassPushConstant)
+				{
+					const Id &block = ids[typeId];
+					uint32_t begin = UINT32_MAX;
+					uint32_t end = 0;
+					for (size_t m = 0; m < block.members.size(); m++)
+					{
+						uint32_t memberOffset = (m < block.memberOffsets.size()) ? block.memberOffsets[m] : 0;
+						uint32_t matrixStride = (m < block.memberMatrixStrides.size()) ? block.memberMatrixStrides[m] : 0;
+						begin = std::min(begin, memberOffset);
+						end = std::max(end, memberOffset + getTypeSize(ids, block.members[m], matrixStride));
+					}
+					if (end > 0)
+					{
+						addPushConstantRange({ stages, begin, end - begin });
+					}
+					continue;
+				}
+
+				if ((variable.storageClass != spv::StorageClassUniformConstant) &&
+					(variable.storageClass != spv::StorageClassUniform) &&
+					(variable.storageClass != storageClassStorageBuffer))
+				{
+					continue;
+				}
+
+				// Arrays of resources
+				uint32_t count = 1;
+				while ((ids[typeId].opcode == spv::OpTypeArray) || (ids[typeId].opcode == spv::OpTypeRuntimeArray))
+				{
+					count = (ids[typeId].opcode == spv::OpTypeArray) ? count * ids[ids[typeId].lengthId].value : 0;
+					typeId = ids[typeId].typeId;
+				}
+
+				VkDescriptorType type;
+				if (!getDescriptorType(ids[typeId], variable.storageClass, &type))
+				{
+					continue;
+				}
+				addBinding({ variable.set, variable.binding, type, count, stages });
+			}
+
+			return true;
+		}
+
+		/**
+		* Add the resources of a SPIR-V file
+		*
+		* @param filename Path of the SPIR-V file
+		*
+		* @return False if the file could not be read or is not a valid SPIR-V module
+		*/
+		bool addShaderFile(const std::string &filename)
+		{
+			MappedFile file;
+			if (!file.open(filename) || !addShader(static_cast<const uint32_t*>(file.data), file.size))
+			{
+				std::cerr << "Error: Could not reflect shader file \"" << filename << "\"" << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/** @brief Use dynamic offsets for a uniform or storage buffer binding */
+		void setDynamic(uint32_t set, uint32_t binding)
+		{
+			Binding *entry = findBinding(set, binding);
+			assert(entry);
+			if (entry->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			{
+				entry->type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			}
+			if (entry->type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+			{
+				entry->type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+			}
+		}
+
+		/** @brief Set the number of descriptors of a binding (e.g. for runtime sized arrays) */
+		void setDescriptorCount(uint32_t set, uint32_t binding, uint32_t count)
+		{
+			Binding *entry = findBinding(set, binding);
+			assert(entry);
+			entry->count = count;
+		}
+
+		/** @brief Check if any of the shaders uses a binding */
+		bool hasBinding(uint32_t set, uint32_t binding) const
+		{
+			return std::any_of(bindings.begin(), bindings.end(), [set, binding](const Binding &entry) { return (entry.set == set) && (entry.binding == binding); });
+		}
+
+		/** @brief All bindings sorted by set and binding */
+		const std::vector<Binding>& getBindings() const
+		{
+			return bindings;
+		}
+
+		/** @brief Number of descriptor set layouts required by the shaders (highest set index + 1) */
+		uint32_t getSetCount() const
+		{
+			uint32_t count = 0;
+			for (auto& entry : bindings)
+			{
+				count = std::max(count, entry.set + 1);
+			}
+			return count;
+		}
+
+		/** @brief Layout bindings of a descriptor set */
+		std::vector<VkDescriptorSetLayoutBinding> getSetLayoutBindings(uint32_t set) const
+		{
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+			for (auto& entry : bindings)
+			{
+				if (entry.set == set)
+				{
+					setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(entry.type, entry.stages, entry.binding, entry.count));
+				}
+			}
+			return setLayoutBindings;
+		}
+
+		/**
+		* Create the layout of a descriptor set
+		*
+		* @param device Logical device to create the layout on
+		* @param set Index of the descriptor set
+		* @param allocationCallbacks (Optional) Host allocation callbacks the layout is created with (and must be destroyed with)
+		*/
+		VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device, uint32_t set, const VkAllocationCallbacks *allocationCallbacks = nullptr) const
+		{
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = getSetLayoutBindings(set);
+			VkDescriptorSetLayoutCreateInfo descriptorLayout =
+				vks::initializers::descriptorSetLayoutCreateInfo(
+					setLayoutBindings.data(),
+					static_cast<uint32_t>(setLayoutBindings.size()));
+			VkDescriptorSetLayout descriptorSetLayout;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, allocationCallbacks, &descriptorSetLayout));
+			return descriptorSetLayout;
+		}
+
+		/** @brief Push constant ranges of all shaders, stages with equal ranges share one entry */
+		const std::vector<VkPushConstantRange>& getPushConstantRanges() const
+		{
+			return pushConstantRanges;
+		}
+
+		/**
+		* Create a pipeline layout with the push constant ranges of the shaders
+		*
+		* @param device Logical device to create the layout on
+		* @param setLayouts Descriptor set layouts, one per set index
+		* @param allocationCallbacks (Optional) Host allocation callbacks the layout is created with (and must be destroyed with)
+		*/
+		VkPipelineLayout createPipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout> &setLayouts, const VkAllocationCallbacks *allocationCallbacks = nullptr) const
+		{
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo =
+				vks::initializers::pipelineLayoutCreateInfo(
+					setLayouts.data(),
+					static_cast<uint32_t>(setLayouts.size()));
+			pipelineLayoutCreateInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+			pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRanges.data();
+			VkPipelineLayout pipelineLayout;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, allocationCallbacks, &pipelineLayout));
+			return pipelineLayout;
+		}
+
+		/**
+		* Get the exact pool sizes for allocating a number of descriptor sets with the same layout
+		*
+		* @param set Index of the descriptor set
+		* @param setCount Number of sets to allocate
+		*/
+		std::vector<VkDescriptorPoolSize> getPoolSizes(uint32_t set, uint32_t setCount) const
+		{
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			for (auto& entry : bindings)
+			{
+				if ((entry.set != set) || (entry.count == 0))
+				{
+					continue;
+				}
+				auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(), [&entry](const VkDescriptorPoolSize &size) { return size.type == entry.type; });
+				if (poolSize != poolSizes.end())
+				{
+					poolSize->descriptorCount += entry.count * setCount;
+				}
+				else
+				{
+					poolSizes.push_back(vks::initializers::descriptorPoolSize(entry.type, entry.count * setCount));
+				}
+			}
+			return poolSizes;
+		}
+
+	private:
+		/** @brief StorageBuffer storage class of SPIR-V 1.3 (not part of the bundled header) */
+		static const uint32_t storageClassStorageBuffer = 12;
+		/** @brief Subpass data image dimension (input attachments) */
+		static const uint32_t dimSubpassData = 6;
+
+		/** @brief Everything needed from an id of a module */
+		struct Id
+		{
+			uint32_t opcode = 0;
+			uint32_t typeId = 0;
+			uint32_t storageClass = 0;
+			uint32_t set = 0;
+			uint32_t binding = 0;
+			bool bufferBlock = false;
+			uint32_t arrayStride = 0;
+			uint32_t width = 0;
+			uint32_t count = 0;
+			uint32_t lengthId = 0;
+			uint32_t value = 0;
+			uint32_t dim = 0;
+			uint32_t sampled = 0;
+			std::vector<uint32_t> members;
+			std::vector<uint32_t> memberOffsets;
+			std::vector<uint32_t> memberMatrixStrides;
+		};
+
+		std::vector<Binding> bindings;
+		std::vector<VkPushConstantRange> pushConstantRanges;
+
+		/** @brief Operand index of the id defined or decorated by the instructions addShader reads, UINT32_MAX for all other instructions */
+		static uint32_t getIdOperand(uint32_t opcode)
+		{
+			switch (opcode)
+			{
+			case spv::OpDecorate:
+			case spv::OpMemberDecorate:
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+			case spv::OpTypeImage:
+			case spv::OpTypeSampler:
+			case spv::OpTypeSampledImage:
+			case spv::OpTypeRuntimeArray:
+			case spv::OpTypeArray:
+			case spv::OpTypeStruct:
+			case spv::OpTypePointer:
+				return 0;
+			case spv::OpConstant:
+			case spv::OpVariable:
+				return 1;
+			default:
+				return UINT32_MAX;
+			}
+		}
+
+		static VkShaderStageFlags getStage(uint32_t executionModel)
+		{
+			switch (executionModel)
+			{
+			case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+			case spv::ExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case spv::ExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: return 0;
+			}
+		}
+
+		static bool getDescriptorType(const Id &type, uint32_t storageClass, VkDescriptorType *descriptorType)
+		{
+			if (storageClass == spv::StorageClassUniform)
+			{
+				// Storage buffers are uniform blocks decorated as buffer blocks before SPIR-V 1.3
+				*descriptorType = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				return true;
+			}
+			if (storageClass == storageClassStorageBuffer)
+			{
+				*descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return true;
+			}
+			switch (type.opcode)
+			{
+			case spv::OpTypeSampledImage:
+				*descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				return true;
+			case spv::OpTypeSampler:
+				*descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				return true;
+			case spv::OpTypeImage:
+				if (type.dim == dimSubpassData)
+				{
+					*descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				}
+				else if (type.dim == spv::DimBuffer)
+				{
+					*descriptorType = (type.sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				}
+				else
+				{
+					*descriptorType = (type.sampled == 2) ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		/** @brief Size of a type in a block with explicit layout */
+		static uint32_t getTypeSize(const std::vector<Id> &ids, uint32_t typeId, uint32_t matrixStride)
+		{
+			const Id &type = ids[typeId];
+			switch (type.opcode)
+			{
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				return type.width / 8;
+			case spv::OpTypeVector:
+				return type.count * getTypeSize(ids, type.typeId, 0);
+			case spv::OpTypeMatrix:
+				return type.count * ((matrixStride > 0) ? matrixStride : getTypeSize(ids, type.typeId, 0));
+			case spv::OpTypeArray:
+				return ids[type.lengthId].value * ((type.arrayStride > 0) ? type.arrayStride : getTypeSize(ids, type.typeId, matrixStride));
+			case spv::OpTypeStruct:
+			{
+				uint32_t size = 0;
+				for (size_t m = 0; m < type.members.size(); m++)
+				{
+					uint32_t memberOffset = (m < type.memberOffsets.size()) ? type.memberOffsets[m] : 0;
+					uint32_t memberMatrixStride = (m < type.memberMatrixStrides.size()) ? type.memberMatrixStrides[m] : 0;
+					size = std::max(size, memberOffset + getTypeSize(ids, type.members[m], memberMatrixStride));
+				}
+				return size;
+			}
+			default:
+				return 0;
+			}
+		}
+
+		Binding* findBinding(uint32_t set, uint32_t binding)
+		{
+			auto entry = std::find_if(bindings.begin(), bindings.end(), [set, binding](const Binding &b) { return (b.set == set) && (b.binding == binding); });
+			return (entry != bindings.end()) ? &(*entry) : nullptr;
+		}
+
+		void addBinding(const Binding &binding)
+		{
+			Binding *entry = findBinding(binding.set, binding.binding);
+			if (entry)
+			{
+				// Already used by another shader (dynamic types set by the caller are kept)
+				entry->stages |= binding.stages;
+				entry->count = std::max(entry->count, binding.count);
+				return;
+			}
+			bindings.push_back(binding);
+			std::sort(bindings.begin(), bindings.end(), [](const Binding &a, const Binding &b) { return (a.set < b.set) || ((a.set == b.set) && (a.binding < b.binding)); });
+		}
+
+		void addPushConstantRange(const VkPushConstantRange &range)
+		{
+			for (auto& entry : pushConstantRanges)
+			{
+				if ((entry.offset == range.offset) && (entry.size == range.size))
+				{
+					entry.stageFlags |= range.stageFlags;
+					return;
+				}
+				if (entry.stageFlags & range.stageFlags)
+				{
+					// Different blocks in multiple modules of the same stage, the stage's range has to cover all of them
+					uint32_t end = std::max(entry.offset + entry.size, range.offset + range.size);
+					entry.offset = std::min(entry.offset, range.offset);
+					entry.size = end - entry.offset;
+					return;
+				}
+			}
+			pushConstantRanges.push_back(range);
+		}
+	};
+}
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include "VulkanDebug.h"
 #include "VulkanBuffer.hpp"
 #include "VulkanDevice.hpp"
+#include "VulkanBarrierBatch.hpp"
 
 #if defined(__ANDROID__)
 #include "VulkanAndroid.h"
@@ -149,19 +150,19 @@ public:
 	{
 		// Free up all Vulkan resources requested by the text overlay
 		vertexBuffer.destroy();
-		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
-		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, imageMemory, nullptr);
-		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
-		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
-		vkDestroyPipelineLayout(vulkanDevice->logicalDevice, pipelineLayout, nullptr);
-		vkDestroyPipelineCache(vulkanDevice->logicalDevice, pipelineCache, nullptr);
-		vkDestroyPipeline(vulkanDevice->logicalDevice, pipeline, nullptr);
-		vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
+		vkDestroySampler(vulkanDevice->logicalDevice, sampler, vulkanDevice->allocationCallbacks);
+		vkDestroyImage(vulkanDevice->logicalDevice, image, vulkanDevice->allocationCallbacks);
+		vkDestroyImageView(vulkanDevice->logicalDevice, view, vulkanDevice->allocationCallbacks);
+		vulkanDevice->freeMemory(imageMemory);
+		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, vulkanDevice->allocationCallbacks);
+		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, vulkanDevice->allocationCallbacks);
+		vkDestroyPipelineLayout(vulkanDevice->logicalDevice, pipelineLayout, vulkanDevice->allocationCallbacks);
+		vkDestroyPipelineCache(vulkanDevice->logicalDevice, pipelineCache, vulkanDevice->allocationCallbacks);
+		vkDestroyPipeline(vulkanDevice->logicalDevice, pipeline, vulkanDevice->allocationCallbacks);
+		vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, vulkanDevice->allocationCallbacks);
 		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
-		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
-		vkDestroyFence(vulkanDevice->logicalDevice, fence, nullptr);
+		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, vulkanDevice->allocationCallbacks);
+		vkDestroyFence(vulkanDevice->logicalDevice, fence, vulkanDevice->allocationCallbacks);
 	}
 
 	/**
@@ -180,7 +181,7 @@ public:
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics; 
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, nullptr, &commandPool));
+		VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, vulkanDevice->allocationCallbacks, &commandPool));
 
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 			vks::initializers::commandBufferAllocateInfo(
@@ -195,7 +196,7 @@ public:
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&vertexBuffer,
-			MAX_CHAR_COUNT * sizeof(glm::vec4)));
+			MAX_CHAR_COUNT * 4 * sizeof(glm::vec4)));
 
 		// Map persistent
 		vertexBuffer.map();
@@ -214,14 +215,14 @@ public:
 		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-		VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageInfo, nullptr, &image));
+		VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageInfo, vulkanDevice->allocationCallbacks, &image));
 
 		VkMemoryRequirements memReqs;
 		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
 		vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, image, &memReqs);
 		allocInfo.allocationSize = memReqs.size;
 		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &imageMemory));
+		VK_CHECK_RESULT(vulkanDevice->allocateMemory(&allocInfo, vks::MEMORY_CATEGORY_TEXTURE, &imageMemory));
 		VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, image, imageMemory, 0));
 
 		// Staging
@@ -246,12 +247,10 @@ public:
 		VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
 
 		// Prepare for transfer
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_PREINITIALIZED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::BarrierBatch barriers;
+		barriers.addImageTransition(image, subresourceRange, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		barriers.flush(copyCmd);
 
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -271,12 +270,8 @@ public:
 			);
 
 		// Prepare for shader read
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		barriers.addImageTransition(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		barriers.flush(copyCmd);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
 
@@ -297,7 +292,7 @@ public:
 		imageViewInfo.format = imageInfo.format;
 		imageViewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,	VK_COMPONENT_SWIZZLE_A };
 		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageViewInfo, nullptr, &view));
+		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageViewInfo, vulkanDevice->allocationCallbacks, &view));
 
 		// Sampler
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
@@ -312,7 +307,7 @@ public:
 		samplerInfo.minLod = 0.0f;
 		samplerInfo.maxLod = 1.0f;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler));
+		VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, vulkanDevice->allocationCallbacks, &sampler));
 
 		// Descriptor
 		// Font uses a separate descriptor pool
@@ -325,7 +320,7 @@ public:
 				poolSizes.data(),
 				1);
 
-		VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, vulkanDevice->allocationCallbacks, &descriptorPool));
 
 		// Descriptor set layout
 		std::array<VkDescriptorSetLayoutBinding, 1> setLayoutBindings;
@@ -336,7 +331,7 @@ public:
 				setLayoutBindings.data(),
 				static_cast<uint32_t>(setLayoutBindings.size()));
 
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorSetLayoutInfo, vulkanDevice->allocationCallbacks, &descriptorSetLayout));
 
 		// Pipeline layout
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo =
@@ -344,7 +339,7 @@ public:
 				&descriptorSetLayout,
 				1);
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutInfo, vulkanDevice->allocationCallbacks, &pipelineLayout));
 
 		// Descriptor set
 		VkDescriptorSetAllocateInfo descriptorSetAllocInfo =
@@ -368,11 +363,11 @@ public:
 		// Pipeline cache
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, vulkanDevice->allocationCallbacks, &pipelineCache));
 
 		// Command buffer execution fence
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
-		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &fence));
+		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, vulkanDevice->allocationCallbacks, &fence));
 	}
 
 	/**
@@ -468,7 +463,7 @@ public:
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCreateInfo.pStages = shaderStages.data();
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(vulkanDevice->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(vulkanDevice->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, vulkanDevice->allocationCallbacks, &pipeline));
 	}
 
 	/**
@@ -549,7 +544,7 @@ public:
 		renderPassInfo.dependencyCount = 2;
 		renderPassInfo.pDependencies = subpassDependencies;
 
-		VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+		VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, vulkanDevice->allocationCallbacks, &renderPass));
 	}
 
 	/**
@@ -610,6 +605,12 @@ public:
 		// Generate a uv mapped quad per char in the new text
 		for (auto letter : text)
 		{
+			// Drop text that doesn't fit into the vertex buffer (four vertices per char)
+			if (numLetters >= MAX_CHAR_COUNT)
+			{
+				break;
+			}
+
 			stb_fontchar *charData = &stbFontData[(uint32_t)letter - STB_FIRST_CHAR];
 
 			mappedLocal->x = (x + (float)charData->x0 * charW);
@@ -20,6 +20,7 @@
 #include "VulkanTools.h"
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "VulkanBarrierBatch.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -27,9 +28,111 @@
 
 namespace vks
 {
+	/**
+	* Staged texture uploads that are recorded into a single command buffer
+	*
+	* The transitions of all images into the transfer layout and into their usage layouts are recorded as one barrier each, so uploading N textures costs two barriers instead of 2N
+	* Pass a batch to the texture loaders and submit it once all textures have been loaded, the textures must not be used before
+	*/
+	class TextureUploadBatch
+	{
+	public:
+		TextureUploadBatch(vks::VulkanDevice *device, VkQueue copyQueue) : device(device), copyQueue(copyQueue) {}
+
+		~TextureUploadBatch()
+		{
+			assert(uploads.empty() && "Texture uploads have not been submitted");
+		}
+
+		/**
+		* Queue the copy of a staging buffer to an image, the batch takes ownership of the staging buffer
+		*
+		* @param stagingBuffer Buffer with the image data, destroyed after the upload
+		* @param stagingMemory Memory of the staging buffer (allocated with VulkanDevice::allocateMemory), freed after the upload
+		* @param image Image in undefined layout that receives the data
+		* @param subresourceRange Mip levels and layers of the image written by the copy regions
+		* @param imageLayout Layout the image is transitioned to after the copy
+		* @param regions Copy regions of the staging buffer
+		*/
+		void add(VkBuffer stagingBuffer, VkDeviceMemory stagingMemory, VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout imageLayout, const std::vector<VkBufferImageCopy> &regions)
+		{
+			Upload upload;
+			upload.stagingBuffer = stagingBuffer;
+			upload.stagingMemory = stagingMemory;
+			upload.image = image;
+			upload.subresourceRange = subresourceRange;
+			upload.imageLayout = imageLayout;
+			upload.regions = regions;
+			uploads.push_back(upload);
+		}
+
+		/** @brief Number of queued uploads */
+		size_t size() const
+		{
+			return uploads.size();
+		}
+
+		/** @brief Record and submit all queued uploads, waits for them to finish and releases the staging buffers */
+		void submit()
+		{
+			if (uploads.empty())
+			{
+				return;
+			}
+			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+			vks::BarrierBatch barriers;
+			for (auto& upload : uploads)
+			{
+				barriers.addImageTransition(upload.image, upload.subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			}
+			barriers.flush(copyCmd);
+
+			for (auto& upload : uploads)
+			{
+				vkCmdCopyBufferToImage(copyCmd, upload.stagingBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(upload.regions.size()), upload.regions.data());
+			}
+
+			for (auto& upload : uploads)
+			{
+				barriers.addImageTransition(upload.image, upload.subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.imageLayout);
+			}
+			barriers.flush(copyCmd);
+
+			device->flushCommandBuffer(copyCmd, copyQueue);
+
+			for (auto& upload : uploads)
+			{
+				device->freeMemory(upload.stagingMemory);
+				vkDestroyBuffer(device->logicalDevice, upload.stagingBuffer, device->allocationCallbacks);
+			}
+			uploads.clear();
+		}
+
+	private:
+		struct Upload
+		{
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingMemory;
+			VkImage image;
+			VkImageSubresourceRange subresourceRange;
+			VkImageLayout imageLayout;
+			std::vector<VkBufferImageCopy> regions;
+		};
+
+		vks::VulkanDevice *device;
+		VkQueue copyQueue;
+		std::vector<Upload> uploads;
+	};
+
 	/** @brief Vulkan texture base class */
 	class Texture {
 	public:
+		Texture() = default;
+		/** @brief Not copyable, the relocation callbacks of the allocation reference the texture object */
+		Texture(const Texture&) = delete;
+		Texture &operator=(const Texture&) = delete;
+
 		vks::VulkanDevice *device;
 		VkImage image;
 		VkImageLayout imageLayout;
@@ -42,6 +145,8 @@ namespace vks
 
 		/** @brief Optional sampler to use with this texture */
 		VkSampler sampler;
+		/** @brief Device memory allocation of optimal tiled images, these can be moved by the memory defragmentation */
+		vks::Allocation *allocation = nullptr;
 
 		/** @brief Update image descriptor from current sampler, view and image layout */
 		void updateDescriptor()
@@ -54,13 +159,106 @@ namespace vks
 		/** @brief Release all Vulkan resources held by this texture */
 		void destroy()
 		{
-			vkDestroyImageView(device->logicalDevice, view, nullptr);
-			vkDestroyImage(device->logicalDevice, image, nullptr);
+			vkDestroyImageView(device->logicalDevice, view, device->allocationCallbacks);
+			vkDestroyImage(device->logicalDevice, image, device->allocationCallbacks);
 			if (sampler)
 			{
-				vkDestroySampler(device->logicalDevice, sampler, nullptr);
+				vkDestroySampler(device->logicalDevice, sampler, device->allocationCallbacks);
+			}
+			if (allocation)
+			{
+				device->memoryAllocator.free(allocation);
+				allocation = nullptr;
+			}
+			else
+			{
+				device->freeMemory(deviceMemory);
 			}
-			vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		}
+
+	protected:
+		/** @brief Create infos kept for recreating image and view if the texture is relocated */
+		struct
+		{
+			VkImageCreateInfo imageCreateInfo;
+			VkImageViewCreateInfo viewCreateInfo;
+		} relocation;
+
+		/**
+		* Create the optimal tiled image of this texture and bind it to device local memory sub-allocated from the device
+		*
+		* @note Adds the transfer usage flags required for staged uploads and for relocating the image during memory defragmentation
+		*/
+		void createImage(VkImageCreateInfo imageCreateInfo)
+		{
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, device->allocationCallbacks, &image));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+			allocation = device->memoryAllocator.allocate(memReqs, device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), vks::MEMORY_CATEGORY_TEXTURE, false);
+			VK_CHECK_RESULT(allocation ? VK_SUCCESS : VK_ERROR_OUT_OF_DEVICE_MEMORY);
+			deviceMemory = allocation->memory;
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, allocation->offset));
+
+			relocation.imageCreateInfo = imageCreateInfo;
+			relocation.imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// The image at the new location is owned by the callbacks until the move is committed, so a discarded move doesn't need the texture object
+			std::shared_ptr<VkImage> target = std::make_shared<VkImage>();
+
+			// Copy all mip levels and layers into a new image at the target location, both images are returned to the usage layout afterwards
+			allocation->copy = [this, target](VkCommandBuffer copyCmd, VkDeviceMemory memory, VkDeviceSize offset)
+			{
+				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &relocation.imageCreateInfo, device->allocationCallbacks, target.get()));
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, *target, memory, offset));
+
+				VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, relocation.imageCreateInfo.mipLevels, 0, relocation.imageCreateInfo.arrayLayers };
+				vks::BarrierBatch barriers;
+				barriers.addImageTransition(image, subresourceRange, imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+				barriers.addImageTransition(*target, subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+				barriers.flush(copyCmd);
+
+				std::vector<VkImageCopy> copyRegions(relocation.imageCreateInfo.mipLevels);
+				for (uint32_t i = 0; i < relocation.imageCreateInfo.mipLevels; i++)
+				{
+					VkImageCopy &copyRegion = copyRegions[i];
+					copyRegion = {};
+					copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, relocation.imageCreateInfo.arrayLayers };
+					copyRegion.dstSubresource = copyRegion.srcSubresource;
+					copyRegion.extent.width = std::max(1u, relocation.imageCreateInfo.extent.width >> i);
+					copyRegion.extent.height = std::max(1u, relocation.imageCreateInfo.extent.height >> i);
+					copyRegion.extent.depth = 1;
+				}
+				vkCmdCopyImage(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, *target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+				// The source image is still used until the move is committed
+				barriers.addImageTransition(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageLayout);
+				barriers.addImageTransition(*target, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+				barriers.flush(copyCmd);
+			};
+			allocation->commit = [this, target]()
+			{
+				vkDestroyImageView(device->logicalDevice, view, device->allocationCallbacks);
+				vkDestroyImage(device->logicalDevice, image, device->allocationCallbacks);
+				image = *target;
+				deviceMemory = allocation->memory;
+				relocation.viewCreateInfo.image = image;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &relocation.viewCreateInfo, device->allocationCallbacks, &view));
+				updateDescriptor();
+			};
+			vks::VulkanDevice *vulkanDevice = device;
+			allocation->discard = [vulkanDevice, target]()
+			{
+				vkDestroyImage(vulkanDevice->logicalDevice, *target, vulkanDevice->allocationCallbacks);
+			};
+		}
+
+		/** @brief Create the image view, the create info is kept so the view can be recreated if the image is relocated */
+		void createView(VkImageViewCreateInfo viewCreateInfo)
+		{
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, device->allocationCallbacks, &view));
+			relocation.viewCreateInfo = viewCreateInfo;
 		}
 	};
 
@@ -77,6 +275,7 @@ namespace vks
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 		* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 		* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
+		* @param (Optional) uploadBatch Batch the staged upload is queued in, if null the texture is uploaded before the function returns
 		*
 		*/
 		void loadFromFile(
@@ -86,7 +285,8 @@ namespace vks
 			VkQueue copyQueue,
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-			bool forceLinear = false)
+			bool forceLinear = false,
+			TextureUploadBatch *uploadBatch = nullptr)
 		{
 #if defined(__ANDROID__)
 			// Textures are stored inside the apk on Android (compressed)
@@ -127,9 +327,6 @@ namespace vks
 			VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 			VkMemoryRequirements memReqs;
 
-			// Use a separate command buffer for texture loading
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
 			if (useStaging)
 			{
 				// Create a host-visible staging buffer that contains the raw image data
@@ -142,7 +339,7 @@ namespace vks
 				bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-				VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+				VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, device->allocationCallbacks, &stagingBuffer));
 
 				// Get memory requirements for the staging buffer (alignment, memory type bits)
 				vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
@@ -151,7 +348,7 @@ namespace vks
 				// Get memory type index for a host visible buffer
 				memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-				VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+				VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, vks::MEMORY_CATEGORY_STAGING, &stagingMemory));
 				VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 				// Copy texture data into staging buffer
@@ -198,15 +395,7 @@ namespace vks
 				{
 					imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 				}
-				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-				vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-				memAllocInfo.allocationSize = memReqs.size;
-
-				memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-				VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+				createImage(imageCreateInfo);
 
 				VkImageSubresourceRange subresourceRange = {};
 				subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -214,41 +403,12 @@ namespace vks
 				subresourceRange.levelCount = mipLevels;
 				subresourceRange.layerCount = 1;
 
-				// Image barrier for optimal image (target)
-				// Optimal image will be used as destination for the copy
-				vks::tools::setImageLayout(
-					copyCmd,
-					image,
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					VK_IMAGE_LAYOUT_UNDEFINED,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					subresourceRange);
-
-				// Copy mip levels from staging buffer
-				vkCmdCopyBufferToImage(
-					copyCmd,
-					stagingBuffer,
-					image,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					static_cast<uint32_t>(bufferCopyRegions.size()),
-					bufferCopyRegions.data()
-				);
-
-				// Change texture image layout to shader read after all mip levels have been copied
+				// The batch transitions the image before and after the copy
 				this->imageLayout = imageLayout;
-				vks::tools::setImageLayout(
-					copyCmd,
-					image,
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					imageLayout,
-					subresourceRange);
-
-				device->flushCommandBuffer(copyCmd, copyQueue);
-
-				// Clean up staging resources
-				vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-				vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+				TextureUploadBatch singleUpload(device, copyQueue);
+				TextureUploadBatch *batch = uploadBatch ? uploadBatch : &singleUpload;
+				batch->add(stagingBuffer, stagingMemory, image, subresourceRange, imageLayout, bufferCopyRegions);
+				singleUpload.submit();
 			}
 			else
 			{
@@ -275,7 +435,7 @@ namespace vks
 				imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
 				// Load mip map level 0 to linear tiling image
-				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
+				VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, device->allocationCallbacks, &mappableImage));
 
 				// Get memory requirements for this image 
 				// like size and alignment
@@ -287,7 +447,7 @@ namespace vks
 				memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
 				// Allocate host memory
-				VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
+				VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, vks::MEMORY_CATEGORY_TEXTURE, &mappableMemory));
 
 				// Bind allocated image for use
 				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
@@ -320,8 +480,10 @@ namespace vks
 				imageLayout = imageLayout;
 
 				// Setup image memory barrier
-				vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
-
+				VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				vks::BarrierBatch barriers;
+				barriers.addImageTransition(image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+				barriers.flush(copyCmd);
 				device->flushCommandBuffer(copyCmd, copyQueue);
 			}
 
@@ -343,7 +505,7 @@ namespace vks
 			samplerCreateInfo.maxAnisotropy = 8;
 			samplerCreateInfo.anisotropyEnable = VK_TRUE;
 			samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, device->allocationCallbacks, &sampler));
 
 			// Create image view
 			// Textures are not directly accessed by the shaders and
@@ -359,7 +521,7 @@ namespace vks
 			// Only set mip map count if optimal tiling is used
 			viewCreateInfo.subresourceRange.levelCount = (useStaging) ? mipLevels : 1;
 			viewCreateInfo.image = image;
-			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+			createView(viewCreateInfo);
 
 			// Update descriptor image info member that can be used for setting up descriptor sets
 			updateDescriptor();
@@ -378,6 +540,7 @@ namespace vks
 		* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 		* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		* @param (Optional) uploadBatch Batch the staged upload is queued in, if null the texture is uploaded before the function returns
 		*/
 		void fromBuffer(
 			void* buffer,
@@ -389,7 +552,8 @@ namespace vks
 			VkQueue copyQueue,
 			VkFilter filter = VK_FILTER_LINEAR,
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			TextureUploadBatch *uploadBatch = nullptr)
 		{
 			assert(buffer);
 
@@ -401,9 +565,6 @@ namespace vks
 			VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 			VkMemoryRequirements memReqs;
 
-			// Use a separate command buffer for texture loading
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
 			// Create a host-visible staging buffer that contains the raw image data
 			VkBuffer stagingBuffer;
 			VkDeviceMemory stagingMemory;
@@ -414,7 +575,7 @@ namespace vks
 			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, device->allocationCallbacks, &stagingBuffer));
 
 			// Get memory requirements for the staging buffer (alignment, memory type bits)
 			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
@@ -423,7 +584,7 @@ namespace vks
 			// Get memory type index for a host visible buffer
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+			VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, vks::MEMORY_CATEGORY_STAGING, &stagingMemory));
 			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 			// Copy texture data into staging buffer
@@ -459,15 +620,7 @@ namespace vks
 			{
 				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 			}
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+			createImage(imageCreateInfo);
 
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -475,41 +628,12 @@ namespace vks
 			subresourceRange.levelCount = mipLevels;
 			subresourceRange.layerCount = 1;
 
-			// Image barrier for optimal image (target)
-			// Optimal image will be used as destination for the copy
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy mip levels from staging buffer
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&bufferCopyRegion
-			);
-
-			// Change texture image layout to shader read after all mip levels have been copied
+			// The batch transitions the image before and after the copy
 			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
-
-			// Clean up staging resources
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			TextureUploadBatch singleUpload(device, copyQueue);
+			TextureUploadBatch *batch = uploadBatch ? uploadBatch : &singleUpload;
+			batch->add(stagingBuffer, stagingMemory, image, subresourceRange, imageLayout, { bufferCopyRegion });
+			singleUpload.submit();
 
 			// Create sampler
 			VkSamplerCreateInfo samplerCreateInfo = {};
@@ -524,7 +648,7 @@ namespace vks
 			samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 			samplerCreateInfo.minLod = 0.0f;
 			samplerCreateInfo.maxLod = 0.0f;
-			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, device->allocationCallbacks, &sampler));
 
 			// Create image view
 			VkImageViewCreateInfo viewCreateInfo = {};
@@ -536,7 +660,7 @@ namespace vks
 			viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 			viewCreateInfo.subresourceRange.levelCount = 1;
 			viewCreateInfo.image = image;
-			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+			createView(viewCreateInfo);
 
 			// Update descriptor image info member that can be used for setting up descriptor sets
 			updateDescriptor();
@@ -556,6 +680,7 @@ namespace vks
 		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 		* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		* @param (Optional) uploadBatch Batch the staged upload is queued in, if null the texture is uploaded before the function returns
 		*
 		*/
 		void loadFromFile(
@@ -564,7 +689,8 @@ namespace vks
 			vks::VulkanDevice *device,
 			VkQueue copyQueue,
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			TextureUploadBatch *uploadBatch = nullptr)
 		{
 #if defined(__ANDROID__)
 			// Textures are stored inside the apk on Android (compressed)
@@ -606,7 +732,7 @@ namespace vks
 			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, device->allocationCallbacks, &stagingBuffer));
 
 			// Get memory requirements for the staging buffer (alignment, memory type bits)
 			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
@@ -615,7 +741,7 @@ namespace vks
 			// Get memory type index for a host visible buffer
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+			VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, vks::MEMORY_CATEGORY_STAGING, &stagingMemory));
 			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 			// Copy texture data into staging buffer
@@ -667,55 +793,21 @@ namespace vks
 			imageCreateInfo.arrayLayers = layerCount;
 			imageCreateInfo.mipLevels = mipLevels;
 
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-			// Use a separate command buffer for texture loading
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			createImage(imageCreateInfo);
 
-			// Image barrier for optimal image (target)
-			// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
+			// All array layers (faces) and mip levels are written by the copy
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresourceRange.baseMipLevel = 0;
 			subresourceRange.levelCount = mipLevels;
 			subresourceRange.layerCount = layerCount;
 
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy the layers and mip levels from the staging buffer to the optimal tiled image
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				static_cast<uint32_t>(bufferCopyRegions.size()),
-				bufferCopyRegions.data());
-
-			// Change texture image layout to shader read after all faces have been copied
+			// The batch transitions the image before and after the copy
 			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			TextureUploadBatch singleUpload(device, copyQueue);
+			TextureUploadBatch *batch = uploadBatch ? uploadBatch : &singleUpload;
+			batch->add(stagingBuffer, stagingMemory, image, subresourceRange, imageLayout, bufferCopyRegions);
+			singleUpload.submit();
 
 			// Create sampler
 			VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -731,7 +823,7 @@ namespace vks
 			samplerCreateInfo.minLod = 0.0f;
 			samplerCreateInfo.maxLod = (float)mipLevels;
 			samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, device->allocationCallbacks, &sampler));
 
 			// Create image view
 			VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -742,11 +834,7 @@ namespace vks
 			viewCreateInfo.subresourceRange.layerCount = layerCount;
 			viewCreateInfo.subresourceRange.levelCount = mipLevels;
 			viewCreateInfo.image = image;
-			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
-
-			// Clean up staging resources
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			createView(viewCreateInfo);
 
 			// Update descriptor image info member that can be used for setting up descriptor sets
 			updateDescriptor();
@@ -765,6 +853,7 @@ namespace vks
 		* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 		* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		* @param (Optional) uploadBatch Batch the staged upload is queued in, if null the texture is uploaded before the function returns
 		*
 		*/
 		void loadFromFile(
@@ -773,7 +862,8 @@ namespace vks
 			vks::VulkanDevice *device,
 			VkQueue copyQueue,
 			VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+			VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			TextureUploadBatch *uploadBatch = nullptr)
 		{
 #if defined(__ANDROID__)
 			// Textures are stored inside the apk on Android (compressed)
@@ -813,7 +903,7 @@ namespace vks
 			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, device->allocationCallbacks, &stagingBuffer));
 
 			// Get memory requirements for the staging buffer (alignment, memory type bits)
 			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
@@ -822,7 +912,7 @@ namespace vks
 			// Get memory type index for a host visible buffer
 			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+			VK_CHECK_RESULT(device->allocateMemory(&memAllocInfo, vks::MEMORY_CATEGORY_STAGING, &stagingMemory));
 			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
 
 			// Copy texture data into staging buffer
@@ -878,55 +968,21 @@ namespace vks
 			imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 
 
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			createImage(imageCreateInfo);
 
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-			// Use a separate command buffer for texture loading
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			// Image barrier for optimal image (target)
-			// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
+			// All array layers (faces) and mip levels are written by the copy
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresourceRange.baseMipLevel = 0;
 			subresourceRange.levelCount = mipLevels;
 			subresourceRange.layerCount = 6;
 
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy the cube map faces from the staging buffer to the optimal tiled image
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				static_cast<uint32_t>(bufferCopyRegions.size()),
-				bufferCopyRegions.data());
-
-			// Change texture image layout to shader read after all faces have been copied
+			// The batch transitions the image before and after the copy
 			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
+			TextureUploadBatch singleUpload(device, copyQueue);
+			TextureUploadBatch *batch = uploadBatch ? uploadBatch : &singleUpload;
+			batch->add(stagingBuffer, stagingMemory, image, subresourceRange, imageLayout, bufferCopyRegions);
+			singleUpload.submit();
 
 			// Create sampler
 			VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -942,7 +998,7 @@ namespace vks
 			samplerCreateInfo.minLod = 0.0f;
 			samplerCreateInfo.maxLod = (float)mipLevels;
 			samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, device->allocationCallbacks, &sampler));
 
 			// Create image view
 			VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -953,11 +1009,7 @@ namespace vks
 			viewCreateInfo.subresourceRange.layerCount = 6;
 			viewCreateInfo.subresourceRange.levelCount = mipLevels;
 			viewCreateInfo.image = image;
-			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
-
-			// Clean up staging resources
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			createView(viewCreateInfo);
 
 			// Update descriptor image info member that can be used for setting up descriptor sets
 			updateDescriptor();
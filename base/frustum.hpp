@@ -6,10 +6,26 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <glm/glm.hpp>
 
+#if defined(__AVX2__)
+#define VKS_FRUSTUM_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKS_FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace vks
 {
 	class Frustum
@@ -18,6 +34,15 @@ namespace vks
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
 		std::array<glm::vec4, 6> planes;
 
+		/** @brief Plane components transposed into separate arrays for the batch tests (set by update) */
+		struct
+		{
+			float x[6];
+			float y[6];
+			float z[6];
+			float w[6];
+		} transposed;
+
 		void update(glm::mat4 matrix)
 		{
 			planes[LEFT].x = matrix[0].w + matrix[0].x;
@@ -50,16 +75,20 @@ namespace vks
 			planes[FRONT].z = matrix[2].w - matrix[2].z;
 			planes[FRONT].w = matrix[3].w - matrix[3].z;
 
-			for (auto i = 0; i < planes.size(); i++)
+			for (size_t i = 0; i < planes.size(); i++)
 			{
 				float length = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
 				planes[i] /= length;
+				transposed.x[i] = planes[i].x;
+				transposed.y[i] = planes[i].y;
+				transposed.z[i] = planes[i].z;
+				transposed.w[i] = planes[i].w;
 			}
 		}
 		
-		bool checkSphere(glm::vec3 pos, float radius)
+		bool checkSphere(glm::vec3 pos, float radius) const
 		{
-			for (auto i = 0; i < planes.size(); i++)
+			for (size_t i = 0; i < planes.size(); i++)
 			{
 				if ((planes[i].x * pos.x) + (planes[i].y * pos.y) + (planes[i].z * pos.z) + planes[i].w <= -radius)
 				{
@@ -68,5 +97,245 @@ namespace vks
 			}
 			return true;
 		}
+
+		/** @brief Check if an axis aligned box given by it's center and (half) extent is at least partially inside the frustum */
+		bool checkBox(glm::vec3 center, glm::vec3 extent) const
+		{
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				// Distance of the box' center and projected extent along the plane normal
+				float distance = (planes[i].x * center.x) + (planes[i].y * center.y) + (planes[i].z * center.z) + planes[i].w;
+				float radius = (fabsf(planes[i].x) * extent.x) + (fabsf(planes[i].y) * extent.y) + (fabsf(planes[i].z) * extent.z);
+				if (distance <= -radius)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		* Check a batch of bounding spheres stored as structure of arrays against the frustum
+		*
+		* @param x X components of the sphere centers
+		* @param y Y components of the sphere centers
+		* @param z Z components of the sphere centers
+		* @param radius Sphere radii
+		* @param count Number of spheres in the batch
+		* @param visibility Bit mask receiving one bit per sphere, set if the sphere is visible (needs (count + 31) / 32 elements)
+		*
+		* @note Uses AVX2 or SSE if enabled at compile time, the results are bit-identical to checkSphere
+		*/
+		void checkSpheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint32_t *visibility) const
+		{
+			memset(visibility, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			size_t i = 0;
+#if defined(VKS_FRUSTUM_AVX2)
+			// Broadcast the plane components once for all spheres
+			__m256 nx[6], ny[6], nz[6], nw[6];
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				nx[p] = _mm256_set1_ps(transposed.x[p]);
+				ny[p] = _mm256_set1_ps(transposed.y[p]);
+				nz[p] = _mm256_set1_ps(transposed.z[p]);
+				nw[p] = _mm256_set1_ps(transposed.w[p]);
+			}
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 px = _mm256_loadu_ps(x + i);
+				__m256 py = _mm256_loadu_ps(y + i);
+				__m256 pz = _mm256_loadu_ps(z + i);
+				__m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(radius + i), _mm256_set1_ps(-0.0f));
+				__m256 culled = _mm256_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					// Same operation order as the scalar test (and no fused multiply-add) to get identical results
+					__m256 distance = _mm256_mul_ps(nx[p], px);
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(ny[p], py));
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(nz[p], pz));
+					distance = _mm256_add_ps(distance, nw[p]);
+					culled = _mm256_or_ps(culled, _mm256_cmp_ps(distance, negRadius, _CMP_LE_OQ));
+				}
+				uint32_t visible = ~static_cast<uint32_t>(_mm256_movemask_ps(culled)) & 0xFFu;
+				visibility[i / 32] |= visible << (i % 32);
+			}
+#elif defined(VKS_FRUSTUM_SSE)
+			// Broadcast the plane components once for all spheres
+			__m128 nx[6], ny[6], nz[6], nw[6];
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				nx[p] = _mm_set1_ps(transposed.x[p]);
+				ny[p] = _mm_set1_ps(transposed.y[p]);
+				nz[p] = _mm_set1_ps(transposed.z[p]);
+				nw[p] = _mm_set1_ps(transposed.w[p]);
+			}
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 px = _mm_loadu_ps(x + i);
+				__m128 py = _mm_loadu_ps(y + i);
+				__m128 pz = _mm_loadu_ps(z + i);
+				__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(radius + i), _mm_set1_ps(-0.0f));
+				__m128 culled = _mm_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					// Same operation order as the scalar test to get identical results
+					__m128 distance = _mm_mul_ps(nx[p], px);
+					distance = _mm_add_ps(distance, _mm_mul_ps(ny[p], py));
+					distance = _mm_add_ps(distance, _mm_mul_ps(nz[p], pz));
+					distance = _mm_add_ps(distance, nw[p]);
+					culled = _mm_or_ps(culled, _mm_cmple_ps(distance, negRadius));
+				}
+				uint32_t visible = ~static_cast<uint32_t>(_mm_movemask_ps(culled)) & 0xFu;
+				visibility[i / 32] |= visible << (i % 32);
+			}
+#endif
+			// Remaining spheres (or all if no SIMD instructions are available)
+			for (; i < count; i++)
+			{
+				if (checkSphere(glm::vec3(x[i], y[i], z[i]), radius[i]))
+				{
+					visibility[i / 32] |= 1u << (i % 32);
+				}
+			}
+		}
+
+		/**
+		* Check a batch of axis aligned boxes stored as structure of arrays against the frustum
+		*
+		* @param x X components of the box centers
+		* @param y Y components of the box centers
+		* @param z Z components of the box centers
+		* @param extentX Half extents of the boxes along the x axis
+		* @param extentY Half extents of the boxes along the y axis
+		* @param extentZ Half extents of the boxes along the z axis
+		* @param count Number of boxes in the batch
+		* @param visibility Bit mask receiving one bit per box, set if the box is visible (needs (count + 31) / 32 elements)
+		*
+		* @note Uses AVX2 or SSE if enabled at compile time, the results are bit-identical to checkBox
+		*/
+		void checkBoxes(const float *x, const float *y, const float *z, const float *extentX, const float *extentY, const float *extentZ, size_t count, uint32_t *visibility) const
+		{
+			memset(visibility, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			size_t i = 0;
+#if defined(VKS_FRUSTUM_AVX2)
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+			// Broadcast the plane components (and the absolute normal components for the projected extents) once for all boxes
+			__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				nx[p] = _mm256_set1_ps(transposed.x[p]);
+				ny[p] = _mm256_set1_ps(transposed.y[p]);
+				nz[p] = _mm256_set1_ps(transposed.z[p]);
+				nw[p] = _mm256_set1_ps(transposed.w[p]);
+				ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+				ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+				az[p] = _mm256_andnot_ps(signMask, nz[p]);
+			}
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256 px = _mm256_loadu_ps(x + i);
+				__m256 py = _mm256_loadu_ps(y + i);
+				__m256 pz = _mm256_loadu_ps(z + i);
+				__m256 ex = _mm256_loadu_ps(extentX + i);
+				__m256 ey = _mm256_loadu_ps(extentY + i);
+				__m256 ez = _mm256_loadu_ps(extentZ + i);
+				__m256 culled = _mm256_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					__m256 distance = _mm256_mul_ps(nx[p], px);
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(ny[p], py));
+					distance = _mm256_add_ps(distance, _mm256_mul_ps(nz[p], pz));
+					distance = _mm256_add_ps(distance, nw[p]);
+					__m256 radius = _mm256_mul_ps(ax[p], ex);
+					radius = _mm256_add_ps(radius, _mm256_mul_ps(ay[p], ey));
+					radius = _mm256_add_ps(radius, _mm256_mul_ps(az[p], ez));
+					culled = _mm256_or_ps(culled, _mm256_cmp_ps(distance, _mm256_xor_ps(radius, signMask), _CMP_LE_OQ));
+				}
+				uint32_t visible = ~static_cast<uint32_t>(_mm256_movemask_ps(culled)) & 0xFFu;
+				visibility[i / 32] |= visible << (i % 32);
+			}
+#elif defined(VKS_FRUSTUM_SSE)
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			// Broadcast the plane components (and the absolute normal components for the projected extents) once for all boxes
+			__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				nx[p] = _mm_set1_ps(transposed.x[p]);
+				ny[p] = _mm_set1_ps(transposed.y[p]);
+				nz[p] = _mm_set1_ps(transposed.z[p]);
+				nw[p] = _mm_set1_ps(transposed.w[p]);
+				ax[p] = _mm_andnot_ps(signMask, nx[p]);
+				ay[p] = _mm_andnot_ps(signMask, ny[p]);
+				az[p] = _mm_andnot_ps(signMask, nz[p]);
+			}
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 px = _mm_loadu_ps(x + i);
+				__m128 py = _mm_loadu_ps(y + i);
+				__m128 pz = _mm_loadu_ps(z + i);
+				__m128 ex = _mm_loadu_ps(extentX + i);
+				__m128 ey = _mm_loadu_ps(extentY + i);
+				__m128 ez = _mm_loadu_ps(extentZ + i);
+				__m128 culled = _mm_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					__m128 distance = _mm_mul_ps(nx[p], px);
+					distance = _mm_add_ps(distance, _mm_mul_ps(ny[p], py));
+					distance = _mm_add_ps(distance, _mm_mul_ps(nz[p], pz));
+					distance = _mm_add_ps(distance, nw[p]);
+					__m128 radius = _mm_mul_ps(ax[p], ex);
+					radius = _mm_add_ps(radius, _mm_mul_ps(ay[p], ey));
+					radius = _mm_add_ps(radius, _mm_mul_ps(az[p], ez));
+					culled = _mm_or_ps(culled, _mm_cmple_ps(distance, _mm_xor_ps(radius, signMask)));
+				}
+				uint32_t visible = ~static_cast<uint32_t>(_mm_movemask_ps(culled)) & 0xFu;
+				visibility[i / 32] |= visible << (i % 32);
+			}
+#endif
+			// Remaining boxes (or all if no SIMD instructions are available)
+			for (; i < count; i++)
+			{
+				if (checkBox(glm::vec3(x[i], y[i], z[i]), glm::vec3(extentX[i], extentY[i], extentZ[i])))
+				{
+					visibility[i / 32] |= 1u << (i % 32);
+				}
+			}
+		}
+
+		/**
+		* Convert a visibility bit mask into a compacted list of the visible indices
+		*
+		* @param visibility Bit mask as written by checkSpheres or checkBoxes
+		* @param count Number of elements the mask was written for
+		* @param indices Receives the indices of the visible elements in ascending order (needs count elements)
+		*
+		* @return Number of visible elements written to indices
+		*/
+		static size_t compact(const uint32_t *visibility, size_t count, uint32_t *indices)
+		{
+			size_t visibleCount = 0;
+			for (size_t word = 0; word < (count + 31) / 32; word++)
+			{
+				uint32_t bits = visibility[word];
+				while (bits != 0)
+				{
+					indices[visibleCount++] = static_cast<uint32_t>(word * 32 + lowestBit(bits));
+					bits &= bits - 1;
+				}
+			}
+			return visibleCount;
+		}
+
+	private:
+		static uint32_t lowestBit(uint32_t bits)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, bits);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+		}
 	};
 }
@@ -29,6 +29,9 @@
 #define KEY_N 0x4E
 #define KEY_O 0x4F
 #define KEY_T 0x54
+#define KEY_I 0x49
+#define KEY_G 0x47
+#define KEY_C 0x43
 #elif defined(__ANDROID__)
 // Dummy key codes 
 #define KEY_ESCAPE 0x0
@@ -52,6 +55,9 @@
 #define KEY_N 0xE
 #define KEY_O 0xF
 #define KEY_T 0x10
+#define KEY_I 0x15
+#define KEY_G 0x16
+#define KEY_C 0x17
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
 #include <linux/input.h>
 
@@ -79,6 +85,9 @@
 #define KEY_N 0x39
 #define KEY_O 0x20
 #define KEY_T 0x1C
+#define KEY_I 0x1F
+#define KEY_G 0x2A
+#define KEY_C 0x36
 #endif
 
 // todo: Android gamepad keycodes outside of define for now
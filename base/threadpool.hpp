@@ -6,7 +6,10 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
+#include <memory>
 #include <thread>
 #include <queue>
 #include <mutex>
@@ -102,7 +105,7 @@ namespace vks
 		void setThreadCount(uint32_t count)
 		{
 			threads.clear();
-			for (auto i = 0; i < count; i++)
+			for (size_t i = 0; i < count; i++)
 			{
 				threads.push_back(make_unique<Thread>());
 			}
@@ -25,6 +25,22 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	// Enable surface extensions depending on os
 	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 
+	// The extended physical device queries are required to read memory budgets (VK_EXT_memory_budget) and extension features (VK_EXT_descriptor_indexing)
+	uint32_t extCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extCount);
+	if ((extCount > 0) && (vkEnumerateInstanceExtensionProperties(nullptr, &extCount, extensions.data()) == VK_SUCCESS))
+	{
+		for (auto& ext : extensions)
+		{
+			if (strcmp(ext.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+			{
+				instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				physicalDeviceProperties2 = true;
+			}
+		}
+	}
+
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceCreateInfo.pNext = NULL;
@@ -43,7 +59,7 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 		instanceCreateInfo.enabledLayerCount = vks::debug::validationLayerCount;
 		instanceCreateInfo.ppEnabledLayerNames = vks::debug::validationLayerNames;
 	}
-	return vkCreateInstance(&instanceCreateInfo, nullptr, &instance);
+	return vkCreateInstance(&instanceCreateInfo, allocationCallbacks, &instance);
 }
 
 std::string VulkanExampleBase::getWindowTitle()
@@ -139,11 +155,38 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	}
 }
 
+std::string VulkanExampleBase::getPipelineCacheFile()
+{
+#if defined(__ANDROID__)
+	// The asset path is read-only on Android
+	return std::string(androidApp->activity->internalDataPath) + "/" + name + ".pipelinecache";
+#else
+	return name + ".pipelinecache";
+#endif
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	// Pipelines created with the data of a previous run don't need to be compiled from SPIR-V again
+	std::vector<char> cacheData;
+	if (settings.persistentPipelineCache)
+	{
+		cacheData = vks::pipelinecache::load(getPipelineCacheFile(), vulkanDevice->properties);
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, allocationCallbacks, &pipelineCache);
+	if ((result != VK_SUCCESS) && !cacheData.empty())
+	{
+		// Data that passed validation may still be rejected by the driver, start with an empty cache instead
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, allocationCallbacks, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
 }
 
 void VulkanExampleBase::prepare()
@@ -154,6 +197,22 @@ void VulkanExampleBase::prepare()
 	}
 	createCommandPool();
 	setupSwapChain();
+
+	// Frames beyond the number of swap chain images would only wait for the frame that rendered to the same image
+	if (frames.size() > swapChain.imageCount)
+	{
+		for (size_t i = swapChain.imageCount; i < frames.size(); i++)
+		{
+			vkDestroyFence(device, frames[i].fence, allocationCallbacks);
+			vkDestroySemaphore(device, frames[i].presentComplete, allocationCallbacks);
+			vkDestroySemaphore(device, frames[i].renderComplete, allocationCallbacks);
+			vkDestroySemaphore(device, frames[i].textOverlayComplete, allocationCallbacks);
+		}
+		frames.resize(swapChain.imageCount);
+		frameDescriptorAllocators.resize(swapChain.imageCount);
+		settings.framesInFlight = swapChain.imageCount;
+	}
+
 	createCommandBuffers();
 	setupDepthStencil();
 	setupRenderPass();
@@ -185,13 +244,23 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	VkPipelineShaderStageCreateInfo shaderStage = {};
 	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStage.stage = stage;
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device, stage);
+	shaderStage.module = shaderModuleCache.load(fileName);
 	shaderStage.pName = "main"; // todo : make param
 	assert(shaderStage.module != VK_NULL_HANDLE);
-	shaderModules.push_back(shaderStage.module);
 	return shaderStage;
 }
 
+void VulkanExampleBase::releaseShaderModules()
+{
+	// Only reported along with the validation output (see vks::debug), the statistics can always be read with shaderModuleCache.getStatistics()
+	if (settings.validation)
+	{
+		vks::ShaderModuleCache::Statistics stats = shaderModuleCache.getStatistics();
+		std::cout << "Shader modules: " << stats.modulesCreated << " created from " << stats.bytesMapped << " bytes, " << stats.pathHits + stats.contentHits << " loads served from the cache" << std::endl;
+	}
+	shaderModuleCache.clear();
+}
+
 void VulkanExampleBase::renderLoop()
 {
 	destWidth = width;
@@ -259,6 +328,9 @@ void VulkanExampleBase::updateTextOverlay()
 	if (!enableTextOverlay)
 		return;
 
+	// The overlay's vertex buffer and command buffers are shared by all frames
+	waitForFramesInFlight();
+
 	textOverlay->beginTextUpdate();
 
 	textOverlay->addText(title, 5.0f, 5.0f, VulkanTextOverlay::alignLeft);
@@ -277,17 +349,121 @@ void VulkanExampleBase::updateTextOverlay()
 
 void VulkanExampleBase::getOverlayText(VulkanTextOverlay *textOverlay)
 {
-	// Can be overriden in derived class
+	// Can be overriden in derived class, call the base implementation to keep the memory statistics
+	if (!settings.memoryStats)
+	{
+		return;
+	}
+
+	const float mb = 1.0f / (1024.0f * 1024.0f);
+	const float x = (float)width - 5.0f;
+	float y = 5.0f;
+	vks::MemoryStatistics stats = vulkanDevice->getMemoryStatistics();
+
+	for (uint32_t i = 0; i < stats.heapCount; i++)
+	{
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1) << "Heap " << i << ((stats.heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (local): " : ": ")
+			<< (stats.heaps[i].usage * mb) << " / " << (stats.heaps[i].budget * mb) << " MB";
+		textOverlay->addText(ss.str(), x, y, VulkanTextOverlay::alignRight);
+		y += 20.0f;
+	}
+
+	if (stats.blocks.count > 0)
+	{
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1) << "Blocks (" << stats.blocks.count << "): " << (stats.blocks.used * mb) << " / " << (stats.blocks.size * mb) << " MB";
+		textOverlay->addText(ss.str(), x, y, VulkanTextOverlay::alignRight);
+		y += 20.0f;
+	}
+
+	for (uint32_t i = 0; i < vks::MEMORY_CATEGORY_COUNT; i++)
+	{
+		if (stats.categories[i].allocationCount == 0)
+		{
+			continue;
+		}
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1) << vks::memoryCategoryName((vks::MemoryCategory)i) << ": "
+			<< (stats.categories[i].allocated * mb) << " MB (" << stats.categories[i].allocationCount << ")";
+		textOverlay->addText(ss.str(), x, y, VulkanTextOverlay::alignRight);
+		y += 20.0f;
+	}
+
+	if (hostAllocator)
+	{
+		const float kb = 1.0f / 1024.0f;
+		vks::HostAllocationStatistics hostStats = hostAllocator->getStatistics();
+		for (uint32_t i = 0; i < VK_SYSTEM_ALLOCATION_SCOPE_RANGE_SIZE; i++)
+		{
+			if (hostStats.scopes[i].totalAllocations == 0)
+			{
+				continue;
+			}
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(1) << "Host " << vks::allocationScopeName((VkSystemAllocationScope)i) << ": "
+				<< (hostStats.scopes[i].allocated * kb) << " KB (" << hostStats.scopes[i].allocationCount << " / " << hostStats.scopes[i].totalAllocations << ")";
+			textOverlay->addText(ss.str(), x, y, VulkanTextOverlay::alignRight);
+			y += 20.0f;
+		}
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1) << "Host arenas: " << (hostStats.arenaSize * kb) << " KB (" << hostStats.arenaAllocations << " allocs)";
+		textOverlay->addText(ss.str(), x, y, VulkanTextOverlay::alignRight);
+	}
 }
 
 void VulkanExampleBase::prepareFrame()
 {
+	FrameSync &frame = frames[frameIndex];
+
+	// Wait until the GPU has finished the frame that used this frame's synchronization primitives last
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+
 	// Acquire the next image from the swap chaing
-	VK_CHECK_RESULT(swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer));
+	VK_CHECK_RESULT(swapChain.acquireNextImage(frame.presentComplete, &currentBuffer));
+
+	// Command buffers are recorded per swap chain image, so the frame that last rendered to this image must have finished
+	if ((imageFences[currentBuffer] != VK_NULL_HANDLE) && (imageFences[currentBuffer] != frame.fence))
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, UINT64_MAX));
+	}
+	imageFences[currentBuffer] = frame.fence;
+	VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+	framePrepared = true;
+
+	// The GPU is done with the sets the frame allocated last time
+	frameDescriptorAllocators[frameIndex].reset();
+
+	submitInfo.pWaitSemaphores = &frame.presentComplete;
+	submitInfo.pSignalSemaphores = &frame.renderComplete;
+}
+
+vks::DescriptorAllocator& VulkanExampleBase::getFrameDescriptorAllocator()
+{
+	return frameDescriptorAllocators[frameIndex];
+}
+
+void VulkanExampleBase::waitForFramesInFlight()
+{
+	std::vector<VkFence> fences;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(frames.size()); i++)
+	{
+		// The fence of a prepared frame has been reset and is only signaled by its own submission, waiting for it would never return
+		if (framePrepared && (i == frameIndex))
+		{
+			continue;
+		}
+		fences.push_back(frames[i].fence);
+	}
+	if (!fences.empty())
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+	}
 }
 
 void VulkanExampleBase::submitFrame()
 {
+	FrameSync &frame = frames[frameIndex];
 	bool submitTextOverlay = enableTextOverlay && textOverlay->visible;
 
 	if (submitTextOverlay)
@@ -299,30 +475,36 @@ void VulkanExampleBase::submitFrame()
 		// Set semaphores
 		// Wait for render complete semaphore
 		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &semaphores.renderComplete;
+		submitInfo.pWaitSemaphores = &frame.renderComplete;
 		// Signal ready with text overlay complete semaphpre
 		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &semaphores.textOverlayComplete;
+		submitInfo.pSignalSemaphores = &frame.textOverlayComplete;
 
 		// Submit current text overlay command buffer
+		// The text overlay is the last submission of the frame, so it signals the frame's fence
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &textOverlay->cmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
 
 		// Reset stage mask
 		submitInfo.pWaitDstStageMask = &submitPipelineStages;
 		// Reset wait and signal semaphores for rendering next frame
 		// Wait for swap chain presentation to finish
 		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 		// Signal ready with offscreen semaphore
 		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+	}
+	else
+	{
+		// A submission without batches signals the fence once all previously submitted work has finished
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frame.fence));
 	}
 
-	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? semaphores.textOverlayComplete : semaphores.renderComplete));
+	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? frame.textOverlayComplete : frame.renderComplete));
 
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// Don't wait for the queue, the next frame's prepareFrame only waits if it reuses resources still in flight
+	framePrepared = false;
+	frameIndex = (frameIndex + 1) % static_cast<uint32_t>(frames.size());
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -353,6 +535,25 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		{
 			settings.fullscreen = true;
 		}
+		if (args[i] == std::string("-memstats"))
+		{
+			settings.memoryStats = true;
+		}
+		if (args[i] == std::string("-hostalloc"))
+		{
+			settings.hostAllocator = true;
+		}
+		if (args[i] == std::string("-nopipelinecache"))
+		{
+			settings.persistentPipelineCache = false;
+		}
+		if ((args[i] == std::string("-framesinflight")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			long frameCount = strtol(args[i + 1], &endptr, 10);
+			// Also limited to the swap chain image count once the swap chain has been created (see prepare)
+			if ((endptr != args[i + 1]) && (frameCount > 0) && (frameCount <= static_cast<long>(maxFramesInFlight))) { settings.framesInFlight = static_cast<uint32_t>(frameCount); };
+		}
 		if ((args[i] == std::string("-w")) || (args[i] == std::string("-width")))
 		{
 			char* endptr;
@@ -368,6 +569,12 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	}
 
 
+	if (settings.hostAllocator)
+	{
+		hostAllocator = new vks::HostAllocator();
+		allocationCallbacks = hostAllocator->getCallbacks();
+	}
+
 	// Enable console if validation is active
 	// Debug message callback will output to it
 	if (this->settings.validation)
@@ -384,6 +591,8 @@ VulkanExampleBase::~VulkanExampleBase()
 	{
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
+	descriptorAllocator.destroy();
+	frameDescriptorAllocators.clear();
 	destroyCommandBuffers();
 	vkDestroyRenderPass(device, renderPass, nullptr);
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
@@ -395,17 +604,30 @@ VulkanExampleBase::~VulkanExampleBase()
 	{
 		vkDestroyShaderModule(device, shaderModule, nullptr);
 	}
+	shaderModuleCache.clear();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.mem);
 
-	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	if (settings.persistentPipelineCache && (pipelineCache != VK_NULL_HANDLE))
+	{
+		// Store the cache including all pipelines created during this run
+		if (!vks::pipelinecache::save(device, pipelineCache, getPipelineCacheFile()))
+		{
+			std::cerr << "Could not write pipeline cache file \"" << getPipelineCacheFile() << "\"" << std::endl;
+		}
+	}
+	vkDestroyPipelineCache(device, pipelineCache, allocationCallbacks);
 
-	vkDestroyCommandPool(device, cmdPool, nullptr);
+	vkDestroyCommandPool(device, cmdPool, allocationCallbacks);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.textOverlayComplete, nullptr);
+	for (auto& frame : frames)
+	{
+		vkDestroyFence(device, frame.fence, allocationCallbacks);
+		vkDestroySemaphore(device, frame.presentComplete, allocationCallbacks);
+		vkDestroySemaphore(device, frame.renderComplete, allocationCallbacks);
+		vkDestroySemaphore(device, frame.textOverlayComplete, allocationCallbacks);
+	}
 
 	if (enableTextOverlay)
 	{
@@ -419,7 +641,10 @@ VulkanExampleBase::~VulkanExampleBase()
 		vks::debug::freeDebugCallback(instance);
 	}
 
-	vkDestroyInstance(instance, nullptr);
+	vkDestroyInstance(instance, allocationCallbacks);
+
+	// All objects created with the host allocator's callbacks have been destroyed
+	delete hostAllocator;
 }
 
 void VulkanExampleBase::initVulkan()
@@ -524,11 +749,18 @@ void VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
+	vulkanDevice->allocationCallbacks = allocationCallbacks;
+	if (physicalDeviceProperties2)
+	{
+		vulkanDevice->getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		vulkanDevice->getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+	}
 	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), "Fatal error");
 	}
 	device = vulkanDevice->logicalDevice;
+	shaderModuleCache.setDevice(device, vulkanDevice->allocationCallbacks);
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
@@ -539,28 +771,51 @@ void VulkanExampleBase::initVulkan()
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
+	// Create synchronization objects for each frame in flight
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queu
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been sumbitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
-	// Will be inserted after the render complete semaphore if the text overlay is enabled
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.textOverlayComplete));
+	// Fences are created signaled so the first wait for each frame returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	frames.resize(settings.framesInFlight);
+	for (auto& frame : frames)
+	{
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, allocationCallbacks, &frame.fence));
+		// Create a semaphore used to synchronize image presentation
+		// Ensures that the image is displayed before we start submitting new commands to the queu
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &frame.presentComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands have been sumbitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &frame.renderComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
+		// Will be inserted after the render complete semaphore if the text overlay is enabled
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, allocationCallbacks, &frame.textOverlayComplete));
+	}
 
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// Semaphores are set to the current frame's ones in prepareFrame
 	// Command buffer submission info is set by each example
 	submitInfo = vks::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
 	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
+	submitInfo.pWaitSemaphores = &frames[0].presentComplete;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+	submitInfo.pSignalSemaphores = &frames[0].renderComplete;
+
+	// Default descriptor allocators, examples can re-initialize them with pool sizes matching their shaders
+	std::vector<VkDescriptorPoolSize> descriptorPoolRatios =
+	{
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+	};
+	descriptorAllocator.init(device, 64, descriptorPoolRatios, vulkanDevice->allocationCallbacks);
+	frameDescriptorAllocators.resize(frames.size());
+	for (auto& allocator : frameDescriptorAllocators)
+	{
+		allocator.init(device, 64, descriptorPoolRatios, vulkanDevice->allocationCallbacks);
+	}
 }
 
 // Win32 : Sets up a console window and redirects standard output to it
@@ -713,6 +968,13 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 				textOverlay->visible = !textOverlay->visible;
 			}
 			break;
+		case KEY_F2:
+			if (enableTextOverlay)
+			{
+				settings.memoryStats = !settings.memoryStats;
+				updateTextOverlay();
+			}
+			break;
 		case KEY_ESCAPE:
 			PostQuitMessage(0);
 			break;
@@ -846,7 +1108,7 @@ void VulkanExampleBase::createCommandPool()
 	cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
 	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, allocationCallbacks, &cmdPool));
 }
 
 void VulkanExampleBase::setupDepthStencil()
@@ -889,7 +1151,7 @@ void VulkanExampleBase::setupDepthStencil()
 	vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
 	mem_alloc.allocationSize = memReqs.size;
 	mem_alloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &mem_alloc, nullptr, &depthStencil.mem));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(&mem_alloc, vks::MEMORY_CATEGORY_FRAMEBUFFER, &depthStencil.mem));
 	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
 
 	depthStencilView.image = depthStencil.image;
@@ -1019,7 +1281,7 @@ void VulkanExampleBase::windowResize()
 
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.mem);
 	setupDepthStencil();
 	
 	for (uint32_t i = 0; i < frameBuffers.size(); i++)
@@ -1064,4 +1326,6 @@ void VulkanExampleBase::initSwapchain()
 void VulkanExampleBase::setupSwapChain()
 {
 	swapChain.create(&width, &height, settings.vsync);
+	// Recreated images have not been rendered to by any frame
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
 }
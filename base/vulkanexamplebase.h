@@ -32,6 +32,10 @@
 
 #include "VulkanInitializers.hpp"
 #include "VulkanDevice.hpp"
+#include "VulkanHostAllocator.hpp"
+#include "VulkanDescriptorAllocator.hpp"
+#include "VulkanPipelineCache.hpp"
+#include "VulkanShaderCache.hpp"
 #include "VulkanSwapChain.hpp"
 #include "VulkanTextOverlay.hpp"
 #include "camera.hpp"
@@ -51,12 +55,18 @@ private:
 	bool resizing = false;
 	// Called if the window is resized and some resources have to be recreatesd
 	void windowResize();
+	/** @brief Set if VK_KHR_get_physical_device_properties2 has been enabled on the instance (required for memory budget and extension feature queries) */
+	bool physicalDeviceProperties2 = false;
 protected:
 	// Last frame time, measured using a high performance timer (if available)
 	float frameTimer = 1.0f;
 	// Frame counter to display fps
 	uint32_t frameCounter = 0;
 	uint32_t lastFPS = 0;
+	/** @brief Tracking host allocator for the driver, only created if requested via settings.hostAllocator */
+	vks::HostAllocator *hostAllocator = nullptr;
+	/** @brief Host allocation callbacks passed to the instance, device and the objects owned by the base class (nullptr for the driver's default allocator) */
+	const VkAllocationCallbacks *allocationCallbacks = nullptr;
 	// Vulkan instance, stores all per-application states
 	VkInstance instance;
 	// Physical device (GPU) that Vulkan will ise
@@ -100,21 +110,40 @@ protected:
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	// Descriptor sets that live as long as the example, pools are added on demand
+	vks::DescriptorAllocator descriptorAllocator;
+	// Descriptor sets that are only used by the frame they have been allocated for (one allocator per frame in flight)
+	// Reset in prepareFrame once the frame's fence has signaled, so the sets must not be used by command buffers that are submitted again in later frames
+	std::vector<vks::DescriptorAllocator> frameDescriptorAllocators;
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
+	// Shader modules loaded with loadShader, each file is only mapped and turned into a module once
+	vks::ShaderModuleCache shaderModuleCache;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
-	// Synchronization semaphores
-	struct {
+	// Upper limit for the number of frames in flight that can be requested with -framesinflight
+	static const uint32_t maxFramesInFlight = 8;
+	// Synchronization primitives of a frame, the CPU can prepare up to settings.framesInFlight frames while the GPU is still processing earlier ones
+	struct FrameSync {
+		// Signaled once all work submitted for the frame has finished
+		VkFence fence;
 		// Swap chain image presentation
 		VkSemaphore presentComplete;
 		// Command buffer submission and execution
 		VkSemaphore renderComplete;
 		// Text overlay submission and execution
 		VkSemaphore textOverlayComplete;
-	} semaphores;
+	};
+	std::vector<FrameSync> frames;
+	// Index of the frame (in frames) that is currently being prepared
+	uint32_t frameIndex = 0;
+	// True between prepareFrame and submitFrame, the current frame's fence is reset and only signaled by the submission of that frame
+	bool framePrepared = false;
+	// Fence of the frame that last rendered to each swap chain image (VK_NULL_HANDLE if not used yet)
+	// Command buffers and per-image resources (e.g. uniform slices) of currentBuffer are safe to update after prepareFrame
+	std::vector<VkFence> imageFences;
 	// Simple texture loader
 	//vks::tools::VulkanTextureLoader *textureLoader = nullptr;
 	// Returns the base asset path (for shaders, models, textures) depending on the os
@@ -132,6 +161,14 @@ public:
 		bool fullscreen = false;
 		/** @brief Set to true if v-sync will be forced for the swapchain */
 		bool vsync = false;
+		/** @brief Show per heap and per category device memory usage in the text overlay (toggle with F2) */
+		bool memoryStats = false;
+		/** @brief Route driver host allocations through a tracking allocator with thread local arenas (-hostalloc) */
+		bool hostAllocator = false;
+		/** @brief Number of frames the CPU may prepare ahead of the GPU (-framesinflight n, at most maxFramesInFlight and the swap chain image count) */
+		uint32_t framesInFlight = 2;
+		/** @brief Load the pipeline cache from disk at startup and store it at shutdown (disable with -nopipelinecache) */
+		bool persistentPipelineCache = true;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -255,14 +292,18 @@ public:
 	// Note : Waits for the queue to become idle
 	void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free);
 
-	// Create a cache pool for rendering pipelines
+	// Create a cache pool for rendering pipelines, initialized with the data stored by the last run (if valid)
 	void createPipelineCache();
+	// Path of the file the pipeline cache is stored in
+	std::string getPipelineCacheFile();
 
 	// Prepare commonly used Vulkan functions
 	virtual void prepare();
 
-	// Load a SPIR-V shader
+	// Load a SPIR-V shader (returns the cached module if the file has been loaded before)
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+	// Destroy all shader modules loaded with loadShader, call once all pipelines have been created
+	void releaseShaderModules();
 	
 	// Start the main render loop
 	void renderLoop();
@@ -271,16 +312,29 @@ public:
 
 	// Called when the text overlay is updating
 	// Can be overriden in derived class to add custom text to the overlay
+	// The base implementation adds the device memory statistics (if enabled)
 	virtual void getOverlayText(VulkanTextOverlay * textOverlay);
 
 	// Prepare the frame for workload submission
+	// - Waits for the fence of the frame whose synchronization primitives are reused
 	// - Acquires the next image from the swap chain 
+	// - Waits for the frame that last rendered to the acquired image (if still in flight)
+	// - Resets the frame's transient descriptor sets
 	// - Sets the default wait and signal semaphores
 	void prepareFrame();
 
 	// Submit the frames' workload 
 	// - Submits the text overlay (if enabled)
+	// - Signals the frame's fence and presents the image without waiting for the queue
 	void submitFrame();
 
+	// Get the transient descriptor allocator of the frame that is currently being prepared
+	vks::DescriptorAllocator& getFrameDescriptorAllocator();
+
+	// Wait for all frames in flight to finish
+	// Required before re-recording command buffers or updating resources that are shared by all frames
+	// Can be called between prepareFrame and submitFrame, the frame that is being prepared has nothing in flight then
+	void waitForFramesInFlight();
+
 };
 
@@ -280,6 +280,12 @@ namespace vks
 			return fileContent;
 		}
 
+		bool fileExists(const std::string &filename)
+		{
+			std::ifstream f(filename.c_str());
+			return f.good();
+		}
+
 		VkShaderModule loadShader(const char *fileName, VkDevice device, VkShaderStageFlagBits stage)
 		{
 			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
@@ -90,6 +90,9 @@ namespace vks
 		// Display error message and exit on fatal error
 		void exitFatal(std::string message, std::string caption);
 
+		// Check if a file exists and can be opened for reading
+		bool fileExists(const std::string &filename);
+
 		// Load a SPIR-V shader (binary) 
 		VkShaderModule loadShader(const char *fileName, VkDevice device, VkShaderStageFlagBits stage);
 
@@ -0,0 +1,141 @@
+/*
+* Frustum culling microbenchmark
+*
+* Compares the batch tests of vks::Frustum (checkSpheres / checkBoxes) against the per element tests (checkSphere / checkBox)
+* for 10k, 100k and 1M random objects and verifies that both produce identical results
+*
+* Build (the SIMD path is selected by the target architecture):
+*   g++ -std=c++14 -O2 -I../base -I../external/glm frustumculling.cpp -o frustumculling                (SSE)
+*   g++ -std=c++14 -O2 -mavx2 -ffp-contract=off -I../base -I../external/glm frustumculling.cpp -o frustumculling  (AVX2)
+*   cl /O2 /EHsc /I..\base /I..\external\glm frustumculling.cpp              (SSE, add /arch:AVX2 for AVX2)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "frustum.hpp"
+
+// Runs per measurement, the average is reported
+const uint32_t RUN_COUNT = 20;
+
+struct Objects
+{
+	std::vector<float> x, y, z;
+	std::vector<float> radius;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+// Random objects around the camera, with the frustum below about 10% of them are visible
+Objects generateObjects(size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	Objects objects;
+	for (size_t i = 0; i < count; i++)
+	{
+		objects.x.push_back(position(rng));
+		objects.y.push_back(position(rng));
+		objects.z.push_back(position(rng));
+		objects.radius.push_back(size(rng));
+		objects.extentX.push_back(size(rng));
+		objects.extentY.push_back(size(rng));
+		objects.extentZ.push_back(size(rng));
+	}
+	return objects;
+}
+
+// Average time of a function in microseconds
+template <typename F>
+double measure(F function)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t run = 0; run < RUN_COUNT; run++)
+	{
+		function();
+	}
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::micro>(tEnd - tStart).count() / RUN_COUNT;
+}
+
+int main()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 256.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	vks::Frustum frustum;
+	frustum.update(projection * view);
+
+#if defined(VKS_FRUSTUM_AVX2)
+	printf("Batch tests: AVX2\n");
+#elif defined(VKS_FRUSTUM_SSE)
+	printf("Batch tests: SSE\n");
+#else
+	printf("Batch tests: scalar\n");
+#endif
+	printf("%10s %8s %14s %14s %14s %14s %11s\n", "objects", "visible", "checkSphere", "checkSpheres", "checkBox", "checkBoxes", "mismatches");
+
+	bool identical = true;
+	for (size_t count : { 10000, 100000, 1000000 })
+	{
+		Objects objects = generateObjects(count, 42);
+		std::vector<uint32_t> scalarSpheres((count + 31) / 32), scalarBoxes((count + 31) / 32);
+		std::vector<uint32_t> batchSpheres((count + 31) / 32), batchBoxes((count + 31) / 32);
+
+		double sphereTime = measure([&]()
+		{
+			std::fill(scalarSpheres.begin(), scalarSpheres.end(), 0);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (frustum.checkSphere(glm::vec3(objects.x[i], objects.y[i], objects.z[i]), objects.radius[i]))
+				{
+					scalarSpheres[i / 32] |= 1u << (i % 32);
+				}
+			}
+		});
+		double spheresTime = measure([&]()
+		{
+			frustum.checkSpheres(objects.x.data(), objects.y.data(), objects.z.data(), objects.radius.data(), count, batchSpheres.data());
+		});
+		double boxTime = measure([&]()
+		{
+			std::fill(scalarBoxes.begin(), scalarBoxes.end(), 0);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (frustum.checkBox(glm::vec3(objects.x[i], objects.y[i], objects.z[i]), glm::vec3(objects.extentX[i], objects.extentY[i], objects.extentZ[i])))
+				{
+					scalarBoxes[i / 32] |= 1u << (i % 32);
+				}
+			}
+		});
+		double boxesTime = measure([&]()
+		{
+			frustum.checkBoxes(objects.x.data(), objects.y.data(), objects.z.data(), objects.extentX.data(), objects.extentY.data(), objects.extentZ.data(), count, batchBoxes.data());
+		});
+
+		// Every element has to get the same result from the batch and the per element test
+		size_t mismatches = 0;
+		size_t visible = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t bit = 1u << (i % 32);
+			mismatches += ((scalarSpheres[i / 32] & bit) != (batchSpheres[i / 32] & bit)) ? 1 : 0;
+			mismatches += ((scalarBoxes[i / 32] & bit) != (batchBoxes[i / 32] & bit)) ? 1 : 0;
+			visible += (batchSpheres[i / 32] & bit) ? 1 : 0;
+		}
+		identical &= (mismatches == 0);
+
+		printf("%10zu %7.1f%% %12.1fus %12.1fus %12.1fus %12.1fus %11zu\n", count, 100.0 * visible / count, sphereTime, spheresTime, boxTime, boxesTime, mismatches);
+	}
+
+	return identical ? 0 : 1;
+}
\ No newline at end of file
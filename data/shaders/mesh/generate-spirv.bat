@@ -1,2 +1,7 @@
 glslangvalidator -V mesh.vert -o mesh.vert.spv
-glslangvalidator -V mesh.frag -o mesh.frag.spv
\ No newline at end of file
+glslangvalidator -V mesh.frag -o mesh.frag.spv
+glslangvalidator -V mesh_indirect.vert -o mesh_indirect.vert.spv
+glslangvalidator -V mesh_instanced.vert -o mesh_instanced.vert.spv
+glslangvalidator -V mesh_pushconstants.vert -o mesh_pushconstants.vert.spv
+glslangvalidator -V mesh_indirect_bindless.vert -o mesh_indirect_bindless.vert.spv
+glslangvalidator -V mesh_bindless.frag -o mesh_bindless.frag.spv
\ No newline at end of file
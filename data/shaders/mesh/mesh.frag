@@ -13,6 +13,9 @@ layout (location = 4) in vec3 inLightVec;
 
 layout (location = 0) out vec4 outFragColor;
 
+// Selected at pipeline creation (feature bit 0 of the pipeline variant)
+layout (constant_id = 0) const bool SPECULAR = true;
+
 void main() 
 {
 	vec4 color = texture(samplerColorMap, inUV) * vec4(inColor, 1.0);
@@ -22,6 +25,6 @@ void main()
 	vec3 V = normalize(inViewVec);
 	vec3 R = reflect(-L, N);
 	vec3 diffuse = max(dot(N, L), 0.0) * inColor;
-	vec3 specular = pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75);
+	vec3 specular = SPECULAR ? pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75) : vec3(0.0);
 	outFragColor = vec4(diffuse * color.rgb + specular, 1.0);		
 }
\ No newline at end of file
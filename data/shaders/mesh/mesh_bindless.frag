@@ -0,0 +1,33 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Color maps of all models, the material of the object selects the texture
+layout (set = 1, binding = 0) uniform sampler2D samplerColorMaps[];
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+layout (location = 5) flat in uint inMaterial;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Selected at pipeline creation (feature bit 0 of the pipeline variant)
+layout (constant_id = 0) const bool SPECULAR = true;
+
+void main() 
+{
+	vec4 color = texture(samplerColorMaps[nonuniformEXT(inMaterial)], inUV) * vec4(inColor, 1.0);
+
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	vec3 V = normalize(inViewVec);
+	vec3 R = reflect(-L, N);
+	vec3 diffuse = max(dot(N, L), 0.0) * inColor;
+	vec3 specular = SPECULAR ? pow(max(dot(R, V), 0.0), 16.0) * vec3(0.75) : vec3(0.0);
+	outFragColor = vec4(diffuse * color.rgb + specular, 1.0);		
+}
\ No newline at end of file
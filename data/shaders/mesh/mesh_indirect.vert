@@ -0,0 +1,50 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inColor;
+
+struct ObjectData
+{
+	mat4 projection;
+	mat4 model;
+	vec4 lightPos;
+	vec4 padding[7];
+};
+
+// Data of all objects, the first instance of the indirect draw command selects the object
+layout (std430, binding = 2) readonly buffer Objects 
+{
+	ObjectData objects[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec3 outViewVec;
+layout (location = 4) out vec3 outLightVec;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	ObjectData object = objects[gl_InstanceIndex];
+
+	outNormal = inNormal;
+	outColor = inColor;
+	outUV = inUV;
+	gl_Position = object.projection * object.model * vec4(inPos.xyz, 1.0);
+	
+	vec4 pos = object.model * vec4(inPos, 1.0);
+	outNormal = mat3(object.model) * inNormal;
+	vec3 lPos = mat3(object.model) * object.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;		
+}
\ No newline at end of file
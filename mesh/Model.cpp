@@ -8,60 +8,28 @@ Model::Model(vks::VulkanDevice *vulkanDevice) : vulkanDevice(vulkanDevice), desc
 
 Model::~Model()
 {
-	destroy(*vulkanDevice);
+	destroy();
 }
 
-void Model::updateUniformBuffer(glm::mat4 perspective, glm::vec3 rotation, float zoom)
+void Model::setupDescriptorSet(vks::DescriptorAllocator &allocator, VkDescriptorSetLayout descriptorSetLayout, const std::vector<VkDescriptorPoolSize> &descriptorCounts, VkDescriptorBufferInfo *objectUniform, VkDescriptorBufferInfo *objectStorage)
 {
-	uboVS.projection = perspective;
+	allocator.allocate(descriptorSetLayout, &descriptorSet, descriptorCounts);
 
-	glm::mat4 viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, zoom));
-
-	uboVS.model = viewMatrix * glm::translate(glm::mat4(), { 0.1f, 1.1f, 0.0f });
-	uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-	uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-	uboVS.model = glm::rotate(uboVS.model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-
-	memcpy(uniformBuffers.scene.mapped, &uboVS, sizeof(uboVS));
+	updateDescriptorSet(objectUniform, objectStorage);
 }
 
-void Model::prepareUniformBuffers()
+void Model::updateDescriptorSet(VkDescriptorBufferInfo *objectUniform, VkDescriptorBufferInfo *objectStorage)
 {
-	// Vertex shader uniform buffer block
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&uniformBuffers.scene,
-		sizeof(uboVS)));
-
-	// Map persistent
-	VK_CHECK_RESULT(uniformBuffers.scene.map())
-}
-
-void Model::setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout)
-{
-	VkDescriptorSetAllocateInfo allocInfo =
-		vks::initializers::descriptorSetAllocateInfo(
-			pool,
-			&descriptorSetLayout,
-			1);
-
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
-
-	VkDescriptorImageInfo texDescriptor =
-		vks::initializers::descriptorImageInfo(
-			textures.colorMap.sampler,
-			textures.colorMap.view,
-			VK_IMAGE_LAYOUT_GENERAL);
+	VkDescriptorImageInfo texDescriptor = getColorMapDescriptor();
 
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets =
 	{
-		// Binding 0 : Vertex shader uniform buffer
+		// Binding 0 : Vertex shader uniform buffer (data of a single object)
 		vks::initializers::writeDescriptorSet(
 			descriptorSet,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			0,
-			&uniformBuffers.scene.descriptor),
+			objectUniform),
 		// Binding 1 : Color map 
 		vks::initializers::writeDescriptorSet(
 			descriptorSet,
@@ -69,16 +37,30 @@ void Model::setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout desc
 			1,
 			&texDescriptor)
 	};
+	if (objectStorage)
+	{
+		// Binding 2 : Vertex shader storage buffer (data of all objects, indexed by the instance)
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(
+			descriptorSet,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+			2,
+			objectStorage));
+	}
 
 	vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 }
 
-void Model::destroy(VkDevice device)
+VkDescriptorImageInfo Model::getColorMapDescriptor()
+{
+	return vks::initializers::descriptorImageInfo(
+		textures.colorMap.sampler,
+		textures.colorMap.view,
+		VK_IMAGE_LAYOUT_GENERAL);
+}
+
+void Model::destroy()
 {
-	vkDestroyBuffer(device, vertices.buffer, nullptr);
-	vkFreeMemory(device, vertices.memory, nullptr);
-	vkDestroyBuffer(device, indices.buffer, nullptr);
-	vkFreeMemory(device, indices.memory, nullptr);
-	uniformBuffers.scene.destroy();
+	vertices.destroy();
+	indices.destroy();
 	textures.colorMap.destroy();
 };
\ No newline at end of file
@@ -1,36 +1,23 @@
 #pragma once
 #include "VulkanBuffer.hpp"
 #include "VulkanTexture.hpp"
+#include "VulkanDescriptorAllocator.hpp"
 
 // Contains all Vulkan resources required to represent vertex and index buffers for a model
 // This is for demonstration and learning purposes, the other examples use a model loader class for easy access
 class Model
 {
 public:
-	struct
-	{
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertices;
-
-	struct
-	{
-		int count;
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} indices;
-
-	struct
-	{
-		glm::mat4 projection;
-		glm::mat4 model;
-		glm::vec4 lightPos = glm::vec4(25.0f, 5.0f, 5.0f, 1.0f);
-	} uboVS;
+	vks::Buffer vertices;
+	vks::Buffer indices;
+	uint32_t indexCount = 0;
 
+	// Bounding sphere in model space
 	struct
 	{
-		vks::Buffer scene;
-	} uniformBuffers;
+		glm::vec3 center;
+		float radius = 0.0f;
+	} bounds;
 
 	struct
 	{
@@ -39,19 +26,24 @@ public:
 
 	vks::VulkanDevice *vulkanDevice;
 	VkDescriptorSet descriptorSet;
+	// Index of the color map in the bindless texture table (if used)
+	uint32_t material = 0;
 
 	Model(vks::VulkanDevice *vulkanDevice);
 	~Model();
 
-	void updateUniformBuffer(glm::mat4 perspective, glm::vec3 rotation, float zoom);
+	// The per object data is owned by the example and shared by all models, the descriptors select it with dynamic offsets
+	// descriptorCounts are the descriptors per set of the layout, so the allocator can move on to the next pool before the current one is exhausted
+	void setupDescriptorSet(vks::DescriptorAllocator &allocator, VkDescriptorSetLayout descriptorSetLayout, const std::vector<VkDescriptorPoolSize> &descriptorCounts, VkDescriptorBufferInfo *objectUniform, VkDescriptorBufferInfo *objectStorage);
 
-	// Prepare and initialize uniform buffer containing shader uniforms
-	void prepareUniformBuffers();
+	// Write the current buffer and texture descriptors to the descriptor set (e.g. after resources have been relocated)
+	void updateDescriptorSet(VkDescriptorBufferInfo *objectUniform, VkDescriptorBufferInfo *objectStorage);
 
-	void setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout);
+	// Descriptor of the color map as sampled by the fragment shader
+	VkDescriptorImageInfo getColorMapDescriptor();
 
 	// Destroys all Vulkan resources created for this model
-	void destroy(VkDevice device);
+	void destroy();
 };
 
 
@@ -10,8 +10,51 @@ struct Vertex
 	glm::vec3 color;
 };
 
-struct Pipelines
+// Per object shader data
+// Read as a uniform buffer by the direct path and from a storage buffer array (indexed by the instance) by the indirect path
+// Padded to 256 bytes, the largest min. offset alignment allowed by the spec, so every object can be bound with a dynamic offset
+struct ObjectData
 {
-	VkPipeline solid;
-	VkPipeline wireframe = VK_NULL_HANDLE;
-};
\ No newline at end of file
+	glm::mat4 projection;
+	glm::mat4 model;
+	glm::vec4 lightPos = glm::vec4(25.0f, 5.0f, 5.0f, 1.0f);
+	// Index of the object's color map in the bindless texture table
+	uint32_t material = 0;
+	uint32_t materialPadding[3];
+	glm::vec4 padding[6];
+};
+
+// Per draw data of the push constant path
+// Only holds the static transform of the object in scene space, the camera matrices of the current frame are read from the scene entry of the object data slice
+// Command buffers are only recorded if the visible objects change, so the pushed data must not depend on the camera
+struct ObjectPushConstants
+{
+	glm::mat4 model;
+};
+
+// Shader programs the pipeline variants are created from
+struct PipelinePrograms
+{
+	uint32_t mesh;
+	// Reads the per object data from the storage buffer for the indirect draw path
+	uint32_t indirect;
+	// Has a per instance vertex binding for the instanced draw path
+	uint32_t instanced;
+	// Reads the per object transform from push constants
+	uint32_t pushConstants;
+	// Indirect variant sampling the color map from the bindless texture table
+	uint32_t bindless;
+};
+
+// Fixed function state bits of the pipeline variants
+enum PipelineStateBits
+{
+	PIPELINE_STATE_WIREFRAME = 0x1
+};
+
+// Shader feature bits of the pipeline variants, bit n is the boolean specialization constant with constant_id n of the fragment shaders
+enum PipelineFeatureBits
+{
+	PIPELINE_FEATURE_SPECULAR = 0x1
+};
+const uint32_t PIPELINE_FEATURE_COUNT = 1;
\ No newline at end of file
@@ -10,24 +10,63 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	enableTextOverlay = true;
 	title = "Vulkan Example - Model rendering";
 
+	numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	threadPool.setThreadCount(numThreads);
+
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		// Render a grid of n x n objects per model
+		if ((args[i] == std::string("-objectgrid")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			long gridSize = strtol(args[i + 1], &endptr, 10);
+			if ((endptr != args[i + 1]) && (gridSize > 0) && (gridSize <= static_cast<long>(maxObjectGridSize))) { objectGridSize = static_cast<uint32_t>(gridSize); };
+		}
+	}
 }
 
 VulkanExample::~VulkanExample()
 {
 	// Clean up used Vulkan resources 
 	// Note : Inherited destructor cleans up resources stored in base class
-	vkDestroyPipeline(device, pipelines.solid, nullptr);
-	if (pipelines.wireframe != VK_NULL_HANDLE)
+	if (settings.persistentPipelineCache)
 	{
-		vkDestroyPipeline(device, pipelines.wireframe, nullptr);
+		// The next run creates the variants used in this run up front
+		pipelineVariants.saveList(getPipelineVariantsFile());
 	}
+	pipelineVariants.destroy();
+
+	vkDestroyPipelineLayout(device, pipelineLayout, vulkanDevice->allocationCallbacks);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, vulkanDevice->allocationCallbacks);
+	bindlessTextures.destroy();
 
-	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	// Resources moved by a pending defragmentation step are switched to their new location before they are destroyed
+	vulkanDevice->endDefragmentation();
 
 	for (auto& model : models)
 	{
-		model->destroy(device);
+		model->destroy();
+	}
+
+	objectData.buffer.destroy();
+	instanceData.buffer.destroy();
+	indirectCommands.destroy();
+
+	for (auto& stage : cullingStages)
+	{
+		stage->destroy();
+		delete stage;
+	}
+
+	for (auto& frame : frameCommands)
+	{
+		frame.graph.destroy();
+	}
+
+	for (auto& thread : threadData)
+	{
+		// Frees the secondary command buffers allocated from the pool
+		vkDestroyCommandPool(device, thread.commandPool, nullptr);
 	}
 }
 
@@ -38,69 +77,561 @@ void VulkanExample::getEnabledFeatures()
 	{
 		enabledFeatures.fillModeNonSolid = VK_TRUE;
 	};
+	// Draw all indirect commands of a model with a single call
+	if (deviceFeatures.multiDrawIndirect)
+	{
+		enabledFeatures.multiDrawIndirect = VK_TRUE;
+	}
+	// The first instance of an indirect command selects the object data, required for the indirect draw path
+	if (deviceFeatures.drawIndirectFirstInstance)
+	{
+		enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
 }
 
-void VulkanExample::reBuildCommandBuffers()
+void VulkanExample::invalidateCommandBuffers(bool segments)
 {
-	if (!checkCommandBuffers())
+	for (auto& frame : frameCommands)
 	{
-		destroyCommandBuffers();
-		createCommandBuffers();
+		frame.dirty = true;
+		if (segments)
+		{
+			for (auto& segment : frame.segments)
+			{
+				segment.dirty = true;
+			}
+		}
 	}
-	buildCommandBuffers();
 }
 
-void VulkanExample::buildCommandBuffers()
+void VulkanExample::queueObjects(vks::RenderQueue &queue, uint32_t imageIndex, const std::vector<uint32_t> &drawObjects)
+{
+	// Handles may have changed since the last build (e.g. buffers relocated by the defragmentation), so the state is registered again
+	queue.reset();
+	uint32_t pipeline;
+	if (pushConstants)
+	{
+		pipeline = queue.registerPipeline(getPipeline(programs.pushConstants));
+	}
+	else
+	{
+		pipeline = queue.registerPipeline(getPipeline(programs.mesh));
+	}
+	std::vector<uint32_t> descriptorSets(models.size());
+	std::vector<uint32_t> meshes(models.size());
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		descriptorSets[m] = queue.registerDescriptorSet(models[m]->descriptorSet);
+		meshes[m] = queue.registerMesh({ models[m]->vertices.buffer, models[m]->indices.buffer, VK_INDEX_TYPE_UINT32 });
+	}
+
+	// Objects are sorted front to back within equal state using the view depth at the time of recording
+	const glm::mat4 viewMatrix = sceneMatrices.view * sceneMatrices.world;
+	for (auto o : drawObjects)
+	{
+		const uint32_t m = objects[o].model;
+		const float depth = -(viewMatrix * glm::vec4(objectBounds.x[o], objectBounds.y[o], objectBounds.z[o], 1.0f)).z;
+		const uint32_t depthBucket = static_cast<uint32_t>(glm::clamp(depth / zFar, 0.0f, 1.0f) * 65535.0f);
+
+		vks::RenderQueue::DrawCommand draw;
+		draw.indexCount = models[m]->indexCount;
+		// Each command buffer reads the object data slice of its swap chain image
+		draw.dynamicOffsetCount = 2;
+		if (pushConstants)
+		{
+			// All draws of a model share the scene entry, so the descriptor set is only bound once per model
+			getObjectOffsets(imageIndex, objects.size(), draw.dynamicOffsets);
+			ObjectPushConstants pushData;
+			pushData.model = glm::translate(glm::mat4(1.0f), objects[o].position);
+			draw.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+			draw.pushConstantsSize = sizeof(pushData);
+			memcpy(draw.pushConstants, &pushData, sizeof(pushData));
+		}
+		else
+		{
+			getObjectOffsets(imageIndex, o, draw.dynamicOffsets);
+		}
+		queue.submit(vks::RenderQueue::makeKey(0, pipeline, descriptorSets[m], meshes[m], depthBucket), draw);
+	}
+	queue.sort();
+}
+
+void VulkanExample::recordObjects(VkCommandBuffer commandBuffer, const vks::RenderQueue &queue, vks::RenderQueue::Statistics *stats)
+{
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// Binds only the state that changes between the sorted draws
+	queue.record(commandBuffer, pipelineLayout, 0, queue.size(), stats);
+}
+
+void VulkanExample::recordIndirect(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// The shader selects the object from the storage buffer slice with the instance index (set by the command's first instance)
+	const bool tableBound = bindIndirectDescriptorSets(commandBuffer, imageIndex);
+	uint32_t dynamicOffsets[2];
+	getObjectOffsets(imageIndex, 0, dynamicOffsets);
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	Model *boundModel = nullptr;
+	size_t v = 0;
+	while (v < visibleObjects.size())
+	{
+		// The command buffer holds one command per object, so a run of consecutive visible objects of the same model is a range of commands
+		uint32_t firstObject = visibleObjects[v];
+		uint32_t commandCount = 1;
+		while ((v + commandCount < visibleObjects.size()) &&
+			(visibleObjects[v + commandCount] == firstObject + commandCount) &&
+			(objects[firstObject + commandCount].model == objects[firstObject].model))
+		{
+			commandCount++;
+		}
+
+		Model *model = models[objects[firstObject].model];
+		if (model != boundModel)
+		{
+			if (!tableBound)
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &model->descriptorSet, 2, dynamicOffsets);
+			}
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &model->vertices.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			boundModel = model;
+		}
+
+		VkDeviceSize commandOffset = firstObject * stride;
+		if (deviceFeatures.multiDrawIndirect)
+		{
+			// The whole range is drawn with a single call
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectCommands.buffer, commandOffset, commandCount, stride);
+		}
+		else
+		{
+			// Without multi draw indirect the draw count must be 0 or 1
+			for (uint32_t j = 0; j < commandCount; j++)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectCommands.buffer, commandOffset + j * stride, 1, stride);
+			}
+		}
+
+		v += commandCount;
+	}
+}
+
+bool VulkanExample::bindIndirectDescriptorSets(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!bindless)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(programs.indirect));
+		return false;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(programs.bindless));
+	// The buffer bindings of all model sets are the same, so any of them provides the object data for all draws
+	// The color map is selected with the material of the object data from the texture table
+	uint32_t dynamicOffsets[2];
+	getObjectOffsets(imageIndex, 0, dynamicOffsets);
+	std::array<VkDescriptorSet, 2> descriptorSets = { models[0]->descriptorSet, bindlessTextures.descriptorSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 2, dynamicOffsets);
+	return true;
+}
+
+void VulkanExample::recordInstanced(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(programs.instanced));
+
+	// The shader selects the object from the storage buffer slice with the object index of the instance
+	uint32_t dynamicOffsets[2];
+	getObjectOffsets(imageIndex, 0, dynamicOffsets);
+
+	// The image's slice of the instance buffer holds the visible objects in the order they are drawn
+	const VkDeviceSize sliceOffset = imageIndex * objects.size() * sizeof(uint32_t);
+	if (!visibleObjects.empty())
+	{
+		instanceData.buffer.copyTo(visibleObjects.data(), visibleObjects.size() * sizeof(uint32_t), sliceOffset);
+		VK_CHECK_RESULT(vulkanDevice->flushMappedBuffers({ &instanceData.buffer }));
+	}
+
+	size_t v = 0;
+	while (v < visibleObjects.size())
+	{
+		// Visible objects are sorted by model, so all visible objects of a model are drawn as instances of one draw
+		const uint32_t modelIndex = objects[visibleObjects[v]].model;
+		uint32_t instanceCount = 1;
+		while ((v + instanceCount < visibleObjects.size()) && (objects[visibleObjects[v + instanceCount]].model == modelIndex))
+		{
+			instanceCount++;
+		}
+
+		Model *model = models[modelIndex];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &model->descriptorSet, 2, dynamicOffsets);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &model->vertices.buffer, offsets);
+		// The instance binding starts at the model's first visible object
+		VkDeviceSize instanceOffset = sliceOffset + v * sizeof(uint32_t);
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instanceData.buffer.buffer, &instanceOffset);
+		vkCmdBindIndexBuffer(commandBuffer, model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(commandBuffer, model->indexCount, instanceCount, 0, 0, 0);
+
+		v += instanceCount;
+	}
+}
+
+void VulkanExample::recordGpuCulled(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// The first instance of the commands written by the culling shader selects the object data
+	const bool tableBound = bindIndirectDescriptorSets(commandBuffer, imageIndex);
+	uint32_t dynamicOffsets[2];
+	getObjectOffsets(imageIndex, 0, dynamicOffsets);
+
+	for (uint32_t m = 0; m < models.size(); m++)
+	{
+		Model *model = models[m];
+		if (!tableBound)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &model->descriptorSet, 2, dynamicOffsets);
+		}
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &model->vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		cullingStages[m]->draw(commandBuffer, imageIndex);
+	}
+}
+
+void VulkanExample::prepareCommandSegments()
+{
+	threadData.resize(numThreads);
+	for (auto& thread : threadData)
+	{
+		if (thread.commandPool == VK_NULL_HANDLE)
+		{
+			VkCommandPoolCreateInfo cmdPoolInfo = {};
+			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+			// Segments are re-recorded individually while those of other images may still be pending
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
+		}
+	}
+
+	if (frameCommands.size() == drawCmdBuffers.size())
+	{
+		return;
+	}
+
+	// The number of swap chain images has changed (the device is idle at this point)
+	for (auto& frame : frameCommands)
+	{
+		frame.graph.destroy();
+		for (auto& segment : frame.segments)
+		{
+			vkFreeCommandBuffers(device, threadData[segment.thread].commandPool, 1, &segment.commandBuffer);
+		}
+	}
+
+	const uint32_t segmentCount = static_cast<uint32_t>((objects.size() + objectsPerSegment - 1) / objectsPerSegment);
+	frameCommands.clear();
+	frameCommands.resize(drawCmdBuffers.size());
+	for (auto& frame : frameCommands)
+	{
+		frame.segments.resize(segmentCount);
+		for (uint32_t s = 0; s < segmentCount; s++)
+		{
+			CommandSegment &segment = frame.segments[s];
+			segment.firstObject = s * objectsPerSegment;
+			segment.lastObject = std::min<uint32_t>(segment.firstObject + objectsPerSegment, static_cast<uint32_t>(objects.size()));
+			// A segment is always recorded by the same thread, as it's command buffer is allocated from that thread's pool
+			segment.thread = s % numThreads;
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+				vks::initializers::commandBufferAllocateInfo(
+					threadData[segment.thread].commandPool,
+					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+					1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &segment.commandBuffer));
+		}
+	}
+}
+
+void VulkanExample::recordCommandSegment(uint32_t imageIndex, uint32_t segmentIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 {
+	CommandSegment &segment = frameCommands[imageIndex].segments[segmentIndex];
+	vks::RenderQueue &queue = threadData[segment.thread].renderQueue;
+
+	queueObjects(queue, imageIndex, segment.objects);
+
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	// Secondary command buffer is executed entirely inside the render pass of the primary
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
 
-	VkClearValue clearValues[2];
-	clearValues[0].color = defaultClearColor;
-	clearValues[1].depthStencil = { 1.0f, 0 };
+	// Implicitly resets the command buffer
+	VK_CHECK_RESULT(vkBeginCommandBuffer(segment.commandBuffer, &cmdBufInfo));
+	// Dynamic state is not inherited from the primary command buffer, so each secondary sets it again
+	recordObjects(segment.commandBuffer, queue, &segment.stats);
+	VK_CHECK_RESULT(vkEndCommandBuffer(segment.commandBuffer));
+
+	segment.dirty = false;
+}
+
+bool VulkanExample::updateCommandSegments(uint32_t imageIndex)
+{
+	FrameCommands &frame = frameCommands[imageIndex];
 
-	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-	renderPassBeginInfo.renderPass = renderPass;
-	renderPassBeginInfo.renderArea.offset.x = 0;
-	renderPassBeginInfo.renderArea.offset.y = 0;
-	renderPassBeginInfo.renderArea.extent.width = width;
-	renderPassBeginInfo.renderArea.extent.height = height;
-	renderPassBeginInfo.clearValueCount = 2;
-	renderPassBeginInfo.pClearValues = clearValues;
+	// Visible objects are sorted by index, so the visible objects of a segment are a contiguous range of the list
+	std::vector<uint32_t> dirtySegments;
+	bool changed = false;
+	auto begin = visibleObjects.begin();
+	for (uint32_t s = 0; s < frame.segments.size(); s++)
+	{
+		CommandSegment &segment = frame.segments[s];
+		auto end = std::lower_bound(begin, visibleObjects.end(), segment.lastObject);
+		if (!std::equal(begin, end, segment.objects.begin(), segment.objects.end()))
+		{
+			segment.objects.assign(begin, end);
+			segment.dirty = true;
+		}
+		begin = end;
+
+		if (!segment.dirty)
+		{
+			continue;
+		}
+		changed = true;
+		if (segment.objects.empty())
+		{
+			// Empty segments are not executed, so there is nothing to record
+			segment.stats = {};
+			segment.dirty = false;
+			continue;
+		}
+		dirtySegments.push_back(s);
+	}
 
-	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+	segmentsRecorded = static_cast<uint32_t>(dirtySegments.size());
+	if (dirtySegments.empty())
 	{
-		// Set target frame buffer
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
+		return changed;
+	}
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = frameBuffers[imageIndex];
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+	if (multiThreaded && (dirtySegments.size() > 1))
+	{
+		// Each worker records the dirty segments allocated from it's pool
+		std::vector<std::vector<uint32_t>> threadSegments(numThreads);
+		for (auto s : dirtySegments)
+		{
+			threadSegments[frame.segments[s].thread].push_back(s);
+		}
+		for (uint32_t t = 0; t < numThreads; t++)
+		{
+			if (threadSegments[t].empty())
+			{
+				continue;
+			}
+			std::vector<uint32_t> *segments = &threadSegments[t];
+			threadPool.threads[t]->addJob([=] {
+				for (auto s : *segments)
+				{
+					recordCommandSegment(imageIndex, s, inheritanceInfo);
+				}
+			});
+		}
+		threadPool.wait();
+	}
+	else
+	{
+		// Pools are only accessed by one thread at a time, so the main thread can record into all of them
+		for (auto s : dirtySegments)
+		{
+			recordCommandSegment(imageIndex, s, inheritanceInfo);
+		}
+	}
 
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	return true;
+}
 
-		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+void VulkanExample::buildCommandBuffer(uint32_t imageIndex)
+{
+	FrameCommands &frame = frameCommands[imageIndex];
 
-		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+	// The frame graph references the slices of this image, which the device doesn't use anymore at this point
+	vks::RenderGraph &graph = frame.graph;
+	graph.destroy();
 
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
+	const VkExtent2D extent = { width, height };
+	uint32_t backbuffer = graph.importImage("backbuffer", swapChain.buffers[imageIndex].image, swapChain.buffers[imageIndex].view, swapChain.colorFormat, extent);
+	graph.markOutput(backbuffer, vks::RENDER_GRAPH_USAGE_PRESENT);
 
-		for (auto model : models)
+	std::vector<uint32_t> cullingCommands;
+	std::vector<uint32_t> cullingStatistics;
+	if (gpuCulling)
+	{
+		// The culling steps of all stages share their barriers, instead of each stage synchronizing it's own steps
+		for (auto& stage : cullingStages)
 		{
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &model->descriptorSet, 0, NULL);
-			// Bind mesh vertex buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &model->vertices.buffer, offsets);
-			// Bind mesh index buffer
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], model->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			// Render mesh vertex buffer using it's indices
-			vkCmdDrawIndexed(drawCmdBuffers[i], model->indices.count, 1, 0, 0, 0);
+			cullingCommands.push_back(graph.importBuffer("culling commands", stage->drawCommands.buffer));
+			cullingStatistics.push_back(graph.importBuffer("culling statistics", stage->statistics.buffer));
 		}
 
-		vkCmdEndRenderPass(drawCmdBuffers[i]);
-		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		uint32_t resetPass = graph.addPass("culling reset", [this, imageIndex](VkCommandBuffer commandBuffer)
+		{
+			for (auto& stage : cullingStages)
+			{
+				stage->recordReset(commandBuffer, imageIndex);
+			}
+		});
+		uint32_t cullPass = graph.addPass("culling", [this, imageIndex](VkCommandBuffer commandBuffer)
+		{
+			for (auto& stage : cullingStages)
+			{
+				stage->recordDispatch(commandBuffer, imageIndex);
+			}
+		});
+		uint32_t statisticsPass = graph.addPass("culling statistics", [this, imageIndex](VkCommandBuffer commandBuffer)
+		{
+			for (auto& stage : cullingStages)
+			{
+				stage->recordStatisticsCopy(commandBuffer, imageIndex);
+			}
+		});
+		for (size_t s = 0; s < cullingStages.size(); s++)
+		{
+			graph.write(resetPass, cullingStatistics[s], vks::RENDER_GRAPH_USAGE_TRANSFER_DST);
+			if (cullingStages[s]->resetsDrawCommands())
+			{
+				graph.write(resetPass, cullingCommands[s], vks::RENDER_GRAPH_USAGE_TRANSFER_DST);
+			}
+			graph.write(cullPass, cullingCommands[s], vks::RENDER_GRAPH_USAGE_STORAGE_WRITE_COMPUTE);
+			graph.write(cullPass, cullingStatistics[s], vks::RENDER_GRAPH_USAGE_STORAGE_WRITE_COMPUTE);
+			// The statistics are read on the host once the image's fence has been signaled (see updateGpuCulling)
+			uint32_t readback = graph.importBuffer("culling readback", cullingStages[s]->readback.buffer);
+			graph.markOutput(readback, vks::RENDER_GRAPH_USAGE_HOST_READ);
+			graph.read(statisticsPass, cullingStatistics[s], vks::RENDER_GRAPH_USAGE_TRANSFER_SRC);
+			graph.write(statisticsPass, readback, vks::RENDER_GRAPH_USAGE_TRANSFER_DST);
+		}
+	}
+
+	const bool useSegments = !indirect && !gpuCulling && !instanced;
+	uint32_t scenePass = graph.addPass("scene", [this, imageIndex, useSegments](VkCommandBuffer commandBuffer)
+	{
+		FrameCommands &frame = frameCommands[imageIndex];
+		if (useSegments)
+		{
+			// The primary only stitches the recorded segments together
+			std::vector<VkCommandBuffer> secondaryCmdBuffers;
+			renderQueueStats = {};
+			for (auto& segment : frame.segments)
+			{
+				if (!segment.objects.empty())
+				{
+					secondaryCmdBuffers.push_back(segment.commandBuffer);
+					renderQueueStats.add(segment.stats);
+				}
+			}
+			if (!secondaryCmdBuffers.empty())
+			{
+				vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCmdBuffers.size()), secondaryCmdBuffers.data());
+			}
+		}
+		// The indirect paths only record a few commands, so they are recorded inline
+		else if (gpuCulling)
+		{
+			recordGpuCulled(commandBuffer, imageIndex);
+		}
+		else if (indirect)
+		{
+			recordIndirect(commandBuffer, imageIndex);
+		}
+		else
+		{
+			recordInstanced(commandBuffer, imageIndex);
+		}
+	});
+	for (size_t s = 0; s < cullingCommands.size(); s++)
+	{
+		graph.read(scenePass, cullingCommands[s], vks::RENDER_GRAPH_USAGE_INDIRECT_READ);
+		if (vulkanDevice->cmdDrawIndexedIndirectCount)
+		{
+			// Draw count
+			graph.read(scenePass, cullingStatistics[s], vks::RENDER_GRAPH_USAGE_INDIRECT_READ);
+		}
+	}
+	graph.write(scenePass, backbuffer, vks::RENDER_GRAPH_USAGE_COLOR_ATTACHMENT);
+
+	std::vector<VkClearValue> clearValues(2);
+	clearValues[0].color = defaultClearColor;
+	clearValues[1].depthStencil = { 1.0f, 0 };
+	// The base render pass keeps the secondary command buffers' inheritance compatible and transitions the swap chain image for presentation
+	graph.useRenderPass(scenePass, renderPass, frameBuffers[imageIndex], extent, clearValues, useSegments ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+	graph.compile(vulkanDevice);
+
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[imageIndex], &cmdBufInfo));
+	graph.execute(drawCmdBuffers[imageIndex]);
+	VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[imageIndex]));
+
+	frame.objects = visibleObjects;
+	frame.dirty = false;
+}
+
+void VulkanExample::updateCommandBuffer(uint32_t imageIndex)
+{
+	FrameCommands &frame = frameCommands[imageIndex];
+	bool record = frame.dirty;
+	if (!indirect && !gpuCulling && !instanced)
+	{
+		// Re-recorded segments invalidate the primary that executes them
+		if (updateCommandSegments(imageIndex))
+		{
+			record = true;
+		}
+	}
+	else if (frame.objects != visibleObjects)
+	{
+		// Only the draws of visible objects are recorded
+		record = true;
+	}
+	if (record)
+	{
+		buildCommandBuffer(imageIndex);
 	}
 }
 
+void VulkanExample::buildCommandBuffers()
+{
+	// Command buffers are recorded right before their swap chain image is used (see updateCommandBuffer)
+	// So any number of changes costs at most one recording per image, and no frames in flight have to be waited for
+	prepareCommandSegments();
+	invalidateCommandBuffers(true);
+}
+
 void VulkanExample::loadModel(std::string filename, Model& model)
 {
 	// Load the model from file using ASSIMP
@@ -156,101 +687,39 @@ void VulkanExample::loadModel(std::string filename, Model& model)
 	}
 	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 
-	model.indices.count = static_cast<uint32_t>(indexBuffer.size());
-
-	// Static mesh should always be device local
-	bool useStaging = true;
-
-	if (useStaging)
-	{
-		struct {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} vertexStaging, indexStaging;
-
-		// Create staging buffers
-		// Vertex data
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBufferSize,
-			&vertexStaging.buffer,
-			&vertexStaging.memory,
-			vertexBuffer.data()));
-		// Index data
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			indexBufferSize,
-			&indexStaging.buffer,
-			&indexStaging.memory,
-			indexBuffer.data()));
-
-		// Create device local buffers
-		// Vertex buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			vertexBufferSize,
-			&model.vertices.buffer,
-			&model.vertices.memory));
-		// Index buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			indexBufferSize,
-			&model.indices.buffer,
-			&model.indices.memory));
-
-		// Copy from staging buffers
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkBufferCopy copyRegion = {};
-
-		copyRegion.size = vertexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			vertexStaging.buffer,
-			model.vertices.buffer,
-			1,
-			&copyRegion);
+	model.indexCount = static_cast<uint32_t>(indexBuffer.size());
 
-		copyRegion.size = indexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			indexStaging.buffer,
-			model.indices.buffer,
-			1,
-			&copyRegion);
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-		vkFreeMemory(device, vertexStaging.memory, nullptr);
-		vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-		vkFreeMemory(device, indexStaging.memory, nullptr);
+	// Bounding sphere around the center of the vertices' extents, used for culling
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+	for (auto& vertex : vertexBuffer)
+	{
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
 	}
-	else
+	model.bounds.center = (minPos + maxPos) * 0.5f;
+	model.bounds.radius = 0.0f;
+	for (auto& vertex : vertexBuffer)
 	{
-		// Vertex buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			vertexBufferSize,
-			&model.vertices.buffer,
-			&model.vertices.memory,
-			vertexBuffer.data()));
-		// Index buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			indexBufferSize,
-			&model.indices.buffer,
-			&model.indices.memory,
-			indexBuffer.data()));
+		model.bounds.radius = std::max(model.bounds.radius, glm::length(vertex.pos - model.bounds.center));
 	}
 
-	model.prepareUniformBuffers();
+	// Static mesh should always be device local
+	// Written directly if device local memory is host visible, staged otherwise
+	// Vertex buffer
+	VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		&model.vertices,
+		vertexBufferSize,
+		vertexBuffer.data(),
+		queue));
+	// Index buffer
+	VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		&model.indices,
+		indexBufferSize,
+		indexBuffer.data(),
+		queue));
 }
 
 void VulkanExample::loadAssets()
@@ -258,27 +727,233 @@ void VulkanExample::loadAssets()
 	const int MODELS_COUNT = 1;
 	models.resize(MODELS_COUNT);
 
+	// All color maps are uploaded with a single submission that transitions them together
+	vks::TextureUploadBatch uploadBatch(vulkanDevice, queue);
 	for (int i = 0; i < MODELS_COUNT; i++)
 	{
 		models[i] = new Model(vulkanDevice);
 		loadModel(getAssetPath() + "models/voyager/voyager.dae", *models[i]);
 		if (deviceFeatures.textureCompressionBC) 
 		{
-			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_bc3_unorm.ktx", VK_FORMAT_BC3_UNORM_BLOCK, vulkanDevice, queue);
+			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_bc3_unorm.ktx", VK_FORMAT_BC3_UNORM_BLOCK, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, &uploadBatch);
 		}
 		else if (deviceFeatures.textureCompressionASTC_LDR) 
 		{
-			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_astc_8x8_unorm.ktx", VK_FORMAT_ASTC_8x8_UNORM_BLOCK, vulkanDevice, queue);
+			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_astc_8x8_unorm.ktx", VK_FORMAT_ASTC_8x8_UNORM_BLOCK, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, &uploadBatch);
 		}
 		else if (deviceFeatures.textureCompressionETC2) 
 		{
-			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_etc2_unorm.ktx", VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, vulkanDevice, queue);
+			models[i]->textures.colorMap.loadFromFile(getAssetPath() + "models/voyager/voyager_etc2_unorm.ktx", VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, &uploadBatch);
 		}
 		else 
 		{
 			vks::tools::exitFatal("Device does not support any compressed texture format!", "Error");
 		}
 	}
+	uploadBatch.submit();
+}
+
+void VulkanExample::prepareBindlessTextures()
+{
+	// The bindless path draws with the indirect pipelines
+	const std::string vertexShader = getAssetPath() + "shaders/mesh/mesh_indirect_bindless.vert.spv";
+	const std::string fragmentShader = getAssetPath() + "shaders/mesh/mesh_bindless.frag.spv";
+	bindlessSupported = vulkanDevice->descriptorIndexing.enabled && deviceFeatures.drawIndirectFirstInstance && vks::tools::fileExists(vertexShader) && vks::tools::fileExists(fragmentShader);
+	if (!bindlessSupported)
+	{
+		return;
+	}
+
+	// All entries of the table count against the per stage limits, even if they are not written
+	const VkPhysicalDeviceLimits &limits = vulkanDevice->properties.limits;
+	const uint32_t capacity = std::min({ maxBindlessTextures, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+	bindlessTextures.create(device, capacity, VK_SHADER_STAGE_FRAGMENT_BIT, vulkanDevice->descriptorIndexing.updateAfterBind, vulkanDevice->allocationCallbacks);
+
+	for (auto& model : models)
+	{
+		model->material = bindlessTextures.add(model->getColorMapDescriptor());
+	}
+}
+
+void VulkanExample::setupObjects()
+{
+	const float spacing = 4.0f;
+	const float gridOffset = (objectGridSize - 1) * spacing * 0.5f;
+
+	objects.clear();
+	for (uint32_t m = 0; m < models.size(); m++)
+	{
+		for (uint32_t x = 0; x < objectGridSize; x++)
+		{
+			for (uint32_t z = 0; z < objectGridSize; z++)
+			{
+				SceneObject object;
+				object.model = m;
+				// Relative to the scene's origin, a single object stays centered
+				object.position = glm::vec3(x * spacing - gridOffset, 0.0f, z * spacing - gridOffset);
+				objects.push_back(object);
+			}
+		}
+	}
+
+	// Bounding spheres in scene space in a structure of arrays layout for batch culling
+	objectBounds.x.clear();
+	objectBounds.y.clear();
+	objectBounds.z.clear();
+	objectBounds.radius.clear();
+	for (auto& object : objects)
+	{
+		const Model *model = models[object.model];
+		glm::vec3 center = object.position + model->bounds.center;
+		objectBounds.x.push_back(center.x);
+		objectBounds.y.push_back(center.y);
+		objectBounds.z.push_back(center.z);
+		objectBounds.radius.push_back(model->bounds.radius);
+	}
+}
+
+void VulkanExample::prepareObjectBuffer()
+{
+	if (objectData.sliceCount > 0)
+	{
+		objectData.buffer.unmap();
+		objectData.buffer.destroy();
+	}
+
+	objectData.sliceCount = swapChain.imageCount;
+	// The entry after the last object holds the scene data of the push constant path
+	objectData.sliceSize = (objects.size() + 1) * sizeof(ObjectData);
+
+	// Read as uniform buffer by the direct and as storage buffer by the indirect path
+	// Written by the host every frame, cached (possibly non-coherent) memory is preferred
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		&objectData.buffer,
+		objectData.sliceSize * objectData.sliceCount));
+
+	// Map persistent
+	VK_CHECK_RESULT(objectData.buffer.map());
+
+	// The offsets into the buffer are passed as dynamic offsets when binding the descriptor sets
+	objectData.uniformDescriptor = { objectData.buffer.buffer, 0, sizeof(ObjectData) };
+	objectData.storageDescriptor = { objectData.buffer.buffer, 0, objectData.sliceSize };
+}
+
+void VulkanExample::prepareInstanceBuffer()
+{
+	if (instanceData.sliceCount > 0)
+	{
+		instanceData.buffer.unmap();
+		instanceData.buffer.destroy();
+	}
+
+	instanceData.sliceCount = swapChain.imageCount;
+
+	// Written by the host whenever a command buffer is recorded, cached (possibly non-coherent) memory is preferred
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		&instanceData.buffer,
+		objects.size() * sizeof(uint32_t) * instanceData.sliceCount));
+
+	// Map persistent
+	VK_CHECK_RESULT(instanceData.buffer.map());
+}
+
+void VulkanExample::getObjectOffsets(uint32_t imageIndex, size_t object, uint32_t *dynamicOffsets)
+{
+	// Object data is padded to the max. allowed min. offset alignment, so all offsets are properly aligned
+	static_assert(sizeof(ObjectData) == 256, "Object data must be padded to 256 bytes");
+	VkDeviceSize sliceOffset = imageIndex * objectData.sliceSize;
+	// Binding 0 : Uniform buffer
+	dynamicOffsets[0] = static_cast<uint32_t>(sliceOffset + object * sizeof(ObjectData));
+	// Binding 2 : Storage buffer
+	dynamicOffsets[1] = static_cast<uint32_t>(sliceOffset);
+}
+
+void VulkanExample::prepareIndirectCommands()
+{
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+
+	for (uint32_t i = 0; i < objects.size(); i++)
+	{
+		VkDrawIndexedIndirectCommand command{};
+		command.indexCount = models[objects[i].model]->indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = 0;
+		command.vertexOffset = 0;
+		// Index of the object's data in the storage buffer
+		command.firstInstance = i;
+		commands.push_back(command);
+	}
+
+	// Only read by the device
+	VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		&indirectCommands,
+		commands.size() * sizeof(VkDrawIndexedIndirectCommand),
+		commands.data(),
+		queue));
+}
+
+void VulkanExample::prepareGpuCulling()
+{
+	// Uses the indirect pipelines to draw the culled objects
+	std::string cullingShader = getAssetPath() + "shaders/base/computeculling.comp.spv";
+	gpuCullingSupported = indirectSupported && vks::tools::fileExists(cullingShader);
+	if (!gpuCullingSupported)
+	{
+		return;
+	}
+
+	VkPipelineShaderStageCreateInfo shaderStage = loadShader(cullingShader, VK_SHADER_STAGE_COMPUTE_BIT);
+	for (uint32_t m = 0; m < models.size(); m++)
+	{
+		// Bounding spheres in scene space, matching the frustum used for CPU culling
+		std::vector<vks::ComputeCulling::Instance> instances;
+		for (uint32_t i = 0; i < objects.size(); i++)
+		{
+			if (objects[i].model != m)
+			{
+				continue;
+			}
+			vks::ComputeCulling::Instance instance;
+			instance.sphere = glm::vec4(objectBounds.x[i], objectBounds.y[i], objectBounds.z[i], objectBounds.radius[i]);
+			instance.firstLod = 0;
+			instance.lodCount = 1;
+			// Selects the object data in the storage buffer
+			instance.firstInstance = i;
+			instances.push_back(instance);
+		}
+		// The models only have a single level of detail
+		std::vector<vks::ComputeCulling::Lod> lods = { { 0, models[m]->indexCount, 0, FLT_MAX } };
+
+		vks::ComputeCulling *stage = new vks::ComputeCulling();
+		stage->multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		stage->prepare(vulkanDevice, queue, pipelineCache, shaderStage, instances, lods, swapChain.imageCount);
+		cullingStages.push_back(stage);
+	}
+}
+
+void VulkanExample::updateGpuCulling()
+{
+	// Camera position in scene space for the level of detail selection
+	glm::vec3 cameraPos = glm::vec3(glm::inverse(sceneMatrices.view * sceneMatrices.world) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	gpuCullingStats = {};
+	for (auto& stage : cullingStages)
+	{
+		// The frame that last used this image has finished, so it's statistics can be read without waiting
+		vks::ComputeCulling::Statistics stats;
+		stage->getStatistics(currentBuffer, &stats);
+		gpuCullingStats.drawCount += stats.drawCount;
+		for (uint32_t i = 0; i < vks::ComputeCulling::maxLodCount; i++)
+		{
+			gpuCullingStats.lodCounts[i] += stats.lodCounts[i];
+		}
+		stage->update(currentBuffer, frustum, cameraPos);
+	}
 }
 
 void VulkanExample::setupVertexDescriptions()
@@ -328,62 +1003,82 @@ void VulkanExample::setupVertexDescriptions()
 	vertices.inputState.pVertexBindingDescriptions = vertices.bindingDescriptions.data();
 	vertices.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertices.attributeDescriptions.size());
 	vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
+
+	// Instanced rendering uses the same vertex layout with an additional per instance binding
+	instancedVertices.bindingDescriptions = vertices.bindingDescriptions;
+	instancedVertices.bindingDescriptions.push_back(
+		vks::initializers::vertexInputBindingDescription(
+			INSTANCE_BUFFER_BIND_ID,
+			sizeof(uint32_t),
+			VK_VERTEX_INPUT_RATE_INSTANCE));
+
+	instancedVertices.attributeDescriptions = vertices.attributeDescriptions;
+	// Location 4 : Object index (per instance)
+	instancedVertices.attributeDescriptions.push_back(
+		vks::initializers::vertexInputAttributeDescription(
+			INSTANCE_BUFFER_BIND_ID,
+			4,
+			VK_FORMAT_R32_UINT,
+			0));
+
+	instancedVertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+	instancedVertices.inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedVertices.bindingDescriptions.size());
+	instancedVertices.inputState.pVertexBindingDescriptions = instancedVertices.bindingDescriptions.data();
+	instancedVertices.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedVertices.attributeDescriptions.size());
+	instancedVertices.inputState.pVertexAttributeDescriptions = instancedVertices.attributeDescriptions.data();
 }
 
 void VulkanExample::setupDescriptorPool()
 {
-	// Example uses one ubo and one combined image sampler
-	std::vector<VkDescriptorPoolSize> poolSizes =
-	{
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
-	};
-
-	VkDescriptorPoolCreateInfo descriptorPoolInfo =
-		vks::initializers::descriptorPoolCreateInfo(
-			static_cast<uint32_t>(poolSizes.size()),
-			poolSizes.data(),
-			1);
-
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+	// Pools are sized for a fixed number of model descriptor sets, scenes with more models chain additional pools
+	descriptorAllocator.init(device, modelSetsPerPool, shaderReflection.getPoolSizes(0, 1), vulkanDevice->allocationCallbacks);
 }
 
 void VulkanExample::setupDescriptorSetLayout()
 {
-	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings =
-	{
-		// Binding 0 : Vertex shader uniform buffer
-		vks::initializers::descriptorSetLayoutBinding(
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0),
-		// Binding 1 : Fragment shader combined sampler
-		vks::initializers::descriptorSetLayoutBinding(
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			VK_SHADER_STAGE_FRAGMENT_BIT,
-			1),
-	};
-
-	VkDescriptorSetLayoutCreateInfo descriptorLayout =
-		vks::initializers::descriptorSetLayoutCreateInfo(
-			setLayoutBindings.data(),
-			static_cast<uint32_t>(setLayoutBindings.size()));
+	// All pipelines share one pipeline layout, so it has to cover the resources of all shaders
+	const std::vector<std::string> shaders = { "mesh.vert", "mesh.frag", "mesh_indirect.vert", "mesh_instanced.vert", "mesh_pushconstants.vert", "mesh_indirect_bindless.vert" };
+	for (auto& shader : shaders)
+	{
+		// Optional shaders that haven't been compiled also don't get a pipeline
+		std::string filename = getAssetPath() + "shaders/mesh/" + shader + ".spv";
+		if (vks::tools::fileExists(filename))
+		{
+			shaderReflection.addShaderFile(filename);
+		}
+	}
 
-	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+	// Binding 0 : Vertex shader uniform buffer (dynamic offset selects the object in the slice of the current swap chain image)
+	shaderReflection.setDynamic(0, 0);
+	// Binding 2 : Vertex shader storage buffer with the data of all objects (dynamic offset selects the slice)
+	if (shaderReflection.hasBinding(0, 2))
+	{
+		shaderReflection.setDynamic(0, 2);
+	}
 
-	VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
-		vks::initializers::pipelineLayoutCreateInfo(
-			&descriptorSetLayout,
-			1);
+	descriptorSetLayout = shaderReflection.createDescriptorSetLayout(device, 0, vulkanDevice->allocationCallbacks);
+	// Includes the push constant range of the per draw transform (shared by all pipelines, so bound descriptor sets stay valid when switching pipelines)
+	// The bindless texture table is set 1, its layout is created by the table as the descriptor array needs binding flags
+	std::vector<VkDescriptorSetLayout> setLayouts = { descriptorSetLayout };
+	if (bindlessSupported)
+	{
+		setLayouts.push_back(bindlessTextures.layout);
+	}
+	pipelineLayout = shaderReflection.createPipelineLayout(device, setLayouts, vulkanDevice->allocationCallbacks);
+}
 
-	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+VkDescriptorBufferInfo* VulkanExample::getObjectStorageDescriptor()
+{
+	// Only written if one of the shaders reads the storage buffer
+	return shaderReflection.hasBinding(0, 2) ? &objectData.storageDescriptor : nullptr;
 }
 
 void VulkanExample::setupDescriptorSet()
 {
+	const std::vector<VkDescriptorPoolSize> descriptorCounts = shaderReflection.getPoolSizes(0, 1);
 	for (auto& model : models)
 	{
-		model->setupDescriptorSet(descriptorPool, descriptorSetLayout);
+		model->setupDescriptorSet(descriptorAllocator, descriptorSetLayout, descriptorCounts, &objectData.uniformDescriptor, getObjectStorageDescriptor());
 	}
 }
 
@@ -436,13 +1131,6 @@ void VulkanExample::preparePipelines()
 			static_cast<uint32_t>(dynamicStateEnables.size()),
 			0);
 
-	// Solid rendering pipeline
-	// Load shaders
-	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-
-	shaderStages[0] = loadShader(getAssetPath() + "shaders/mesh/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-	shaderStages[1] = loadShader(getAssetPath() + "shaders/mesh/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
 	VkGraphicsPipelineCreateInfo pipelineCreateInfo =
 		vks::initializers::pipelineCreateInfo(
 			pipelineLayout,
@@ -457,25 +1145,199 @@ void VulkanExample::preparePipelines()
 	pipelineCreateInfo.pViewportState = &viewportState;
 	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
 	pipelineCreateInfo.pDynamicState = &dynamicState;
-	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
-	pipelineCreateInfo.pStages = shaderStages.data();
 
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
+	// The registry copies the state of each program, variants can be created long after this function has returned
+	pipelineVariants.init(device, pipelineCache, [](uint32_t state, vks::PipelineState &pipelineState)
+	{
+		// Wireframe variants only differ in the polygon mode
+		if (state & PIPELINE_STATE_WIREFRAME)
+		{
+			pipelineState.rasterization.polygonMode = VK_POLYGON_MODE_LINE;
+			pipelineState.rasterization.lineWidth = 1.0f;
+		}
+	}, vulkanDevice->allocationCallbacks);
+	// Variants that are known to be used are created in parallel on the worker threads before the first frame
+	std::vector<uint64_t> prewarmKeys;
+	auto addProgram = [&](std::array<VkPipelineShaderStageCreateInfo, 2> stages, VkPipelineVertexInputStateCreateInfo *vertexInputState, const std::string &name)
+	{
+		VkGraphicsPipelineCreateInfo createInfo = pipelineCreateInfo;
+		createInfo.stageCount = static_cast<uint32_t>(stages.size());
+		createInfo.pStages = stages.data();
+		createInfo.pVertexInputState = vertexInputState;
+		uint32_t program = pipelineVariants.addProgram(createInfo, PIPELINE_FEATURE_COUNT, name);
+		prewarmKeys.push_back(vks::PipelineVariants::makeKey(program, 0, PIPELINE_FEATURE_SPECULAR));
+		return program;
+	};
+
+	// Default rendering pipelines
+	VkPipelineShaderStageCreateInfo fragmentStage = loadShader(getAssetPath() + "shaders/mesh/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	programs.mesh = addProgram({ loadShader(getAssetPath() + "shaders/mesh/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT), fragmentStage }, &vertices.inputState, "mesh");
+
+	// Indirect rendering pipelines
+	// The vertex shader reads the object data from the storage buffer using the instance index, which requires a non-zero first instance
+	std::string indirectShader = getAssetPath() + "shaders/mesh/mesh_indirect.vert.spv";
+	indirectSupported = deviceFeatures.drawIndirectFirstInstance && vks::tools::fileExists(indirectShader);
+	if (indirectSupported)
+	{
+		programs.indirect = addProgram({ loadShader(indirectShader, VK_SHADER_STAGE_VERTEX_BIT), fragmentStage }, &vertices.inputState, "indirect");
+	}
+
+	// Bindless rendering pipelines
+	// Variant of the indirect pipelines that samples the color map selected by the object's material from the texture table
+	bindlessSupported = bindlessSupported && indirectSupported;
+	if (bindlessSupported)
+	{
+		programs.bindless = addProgram({ loadShader(getAssetPath() + "shaders/mesh/mesh_indirect_bindless.vert.spv", VK_SHADER_STAGE_VERTEX_BIT), loadShader(getAssetPath() + "shaders/mesh/mesh_bindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT) }, &vertices.inputState, "bindless");
+	}
+	bindless = bindlessSupported;
+
+	// Push constant rendering pipelines
+	// The vertex shader combines the per draw transform from the push constants with the camera matrices of the scene entry
+	std::string pushConstantsShader = getAssetPath() + "shaders/mesh/mesh_pushconstants.vert.spv";
+	pushConstantsSupported = (sizeof(ObjectPushConstants) <= vulkanDevice->properties.limits.maxPushConstantsSize) && vks::tools::fileExists(pushConstantsShader);
+	if (pushConstantsSupported)
+	{
+		programs.pushConstants = addProgram({ loadShader(pushConstantsShader, VK_SHADER_STAGE_VERTEX_BIT), fragmentStage }, &vertices.inputState, "push constants");
+	}
+	// Default path for the direct draws if available
+	pushConstants = pushConstantsSupported;
+
+	// Instanced rendering pipelines
+	// The vertex shader reads the object data from the storage buffer using the object index of the per instance binding
+	std::string instancedShader = getAssetPath() + "shaders/mesh/mesh_instanced.vert.spv";
+	instancedSupported = vks::tools::fileExists(instancedShader);
+	if (instancedSupported)
+	{
+		programs.instanced = addProgram({ loadShader(instancedShader, VK_SHADER_STAGE_VERTEX_BIT), fragmentStage }, &instancedVertices.inputState, "instanced");
+	}
+
+	// Variants of all programs with the default state, and the variants the last run has used (e.g. wireframe)
+	if (settings.persistentPipelineCache)
+	{
+		std::vector<uint64_t> usedKeys = vks::PipelineVariants::loadList(getPipelineVariantsFile());
+		prewarmKeys.insert(prewarmKeys.end(), usedKeys.begin(), usedKeys.end());
+	}
+	pipelineVariants.prewarm(prewarmKeys, &threadPool);
+
+	std::cout << "Created " << pipelineVariants.prewarmTimings.size() << " pipelines in " << pipelineVariants.prewarmTime << " ms" << std::endl;
+	for (auto& timing : pipelineVariants.prewarmTimings)
+	{
+		std::cout << "  " << timing.name << ": " << timing.milliseconds << " ms" << std::endl;
+	}
+}
+
+VkPipeline VulkanExample::getPipeline(uint32_t program)
+{
+	uint32_t state = wireframe ? PIPELINE_STATE_WIREFRAME : 0;
+	uint32_t features = specular ? PIPELINE_FEATURE_SPECULAR : 0;
+	const uint64_t key = vks::PipelineVariants::makeKey(program, state, features);
+	if (asyncPipelines)
+	{
+		return pipelineVariants.request(key, vks::PipelineVariants::makeKey(program, 0, PIPELINE_FEATURE_SPECULAR));
+	}
+	return pipelineVariants.get(key);
+}
+
+std::string VulkanExample::getPipelineVariantsFile()
+{
+	return getPipelineCacheFile() + ".variants";
+}
+
+void VulkanExample::updateSceneMatrices()
+{
+	sceneMatrices.projection = glm::perspective(glm::radians(60.0f), (float)width / (float)height, zNear, zFar);
+
+	sceneMatrices.view = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, zoom));
+
+	sceneMatrices.world = glm::translate(glm::mat4(), { 0.1f, 1.1f, 0.0f });
+	sceneMatrices.world = glm::rotate(sceneMatrices.world, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	sceneMatrices.world = glm::rotate(sceneMatrices.world, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	sceneMatrices.world = glm::rotate(sceneMatrices.world, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+}
 
-	// Wire frame rendering pipeline
-	if (deviceFeatures.fillModeNonSolid) {
-		rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-		rasterizationState.lineWidth = 1.0f;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.wireframe));
+void VulkanExample::cullObjects()
+{
+	// The frustum is transformed into the scene's space, so the static bounding spheres can be tested without transforming them
+	// The scene is only translated and rotated, so distances to the planes are the same as in view space
+	frustum.update(sceneMatrices.projection * sceneMatrices.view * sceneMatrices.world);
+
+	size_t count = objects.size();
+	if (gpuCulling)
+	{
+		// Culled on the device, so the command buffers and object data have to cover all objects
+		visibleObjects.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			visibleObjects[i] = i;
+		}
+		return;
 	}
+
+	objectBounds.visibility.resize((count + 31) / 32);
+	frustum.checkSpheres(objectBounds.x.data(), objectBounds.y.data(), objectBounds.z.data(), objectBounds.radius.data(), count, objectBounds.visibility.data());
+
+	// Keeps the order of the objects, so the visible objects stay sorted by model
+	visibleObjects.resize(count);
+	visibleObjects.resize(vks::Frustum::compact(objectBounds.visibility.data(), count, visibleObjects.data()));
 }
 
 void VulkanExample::updateUniformBuffers()
 {
-	for (auto model : models)
+	ObjectData data;
+	data.projection = sceneMatrices.projection;
+
+	glm::mat4 sceneMatrix = sceneMatrices.view * sceneMatrices.world;
+
+	// Only the slice of the acquired image is written, culled objects are not read by the device
+	VkDeviceSize sliceOffset = currentBuffer * objectData.sliceSize;
+
+	// The push constant path only reads the scene entry, the object transforms are part of the command buffers
+	data.model = sceneMatrix;
+	objectData.buffer.copyTo(&data, sizeof(data), sliceOffset + objects.size() * sizeof(ObjectData));
+	if (!pushConstants || indirect || gpuCulling || instanced)
+	{
+		for (auto i : visibleObjects)
+		{
+			data.model = glm::translate(sceneMatrix, objects[i].position);
+			data.material = models[objects[i].model]->material;
+			objectData.buffer.copyTo(&data, sizeof(data), sliceOffset + i * sizeof(ObjectData));
+		}
+	}
+	// Make the writes of all objects visible to the device with a single flush (no-op for coherent memory)
+	VK_CHECK_RESULT(vulkanDevice->flushMappedBuffers({ &objectData.buffer }));
+}
+
+void VulkanExample::defragmentMemory()
+{
+	if (!vulkanDevice->defragmentationPending())
+	{
+		// The copies run on the queue alongside the frames, the moved resources are used at their old location until the step is finished
+		vulkanDevice->beginDefragmentation(queue, defragmentationBudget);
+		return;
+	}
+	if (!vulkanDevice->defragmentationCopiesFinished())
 	{
-		glm::mat4 perspective = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f);
-		model->updateUniformBuffer(perspective, rotation, zoom);
+		return;
+	}
+	// Frames submitted after the copies still use the old buffers, images and descriptor sets, which are destroyed or rewritten when the step is finished
+	waitForFramesInFlight();
+	vks::DefragmentationStats stats = vulkanDevice->endDefragmentation();
+	if (stats.allocationsMoved > 0)
+	{
+		// Moved buffers and images have new handles, so descriptors and command buffers need to be updated
+		for (auto& model : models)
+		{
+			model->updateDescriptorSet(&objectData.uniformDescriptor, getObjectStorageDescriptor());
+			if (bindlessSupported)
+			{
+				bindlessTextures.update(model->material, model->getColorMapDescriptor());
+			}
+		}
+		for (auto& stage : cullingStages)
+		{
+			stage->updateDescriptorSet();
+		}
+		buildCommandBuffers();
 	}
 }
 
@@ -483,6 +1345,23 @@ void VulkanExample::draw()
 {
 	VulkanExampleBase::prepareFrame();
 
+	updateSceneMatrices();
+	cullObjects();
+
+	// Command buffers recorded with fallback pipelines are recorded again with the variants that have finished compiling
+	if (pipelineVariants.pollCompleted())
+	{
+		invalidateCommandBuffers(true);
+	}
+
+	// The object data slice and the command buffer of the acquired image are no longer used by the GPU
+	updateUniformBuffers();
+	if (gpuCulling)
+	{
+		updateGpuCulling();
+	}
+	updateCommandBuffer(currentBuffer);
+
 	// Command buffer to be sumitted to the queue
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -497,12 +1376,20 @@ void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
 	loadAssets();
+	prepareBindlessTextures();
+	setupObjects();
+	prepareObjectBuffer();
+	prepareInstanceBuffer();
+	prepareIndirectCommands();
 	setupVertexDescriptions();
 	setupDescriptorSetLayout();
 	preparePipelines();
+	prepareGpuCulling();
+	// Shader modules are kept, as the pipeline variants that haven't been prewarmed are created on first use
 	setupDescriptorPool();
 	setupDescriptorSet();
-	updateUniformBuffers();
+	updateSceneMatrices();
+	cullObjects();
 	buildCommandBuffers();
 	prepared = true;
 }
@@ -511,18 +1398,28 @@ void VulkanExample::render()
 {
 	if (!prepared)
 		return;
-	vkDeviceWaitIdle(device);
+	defragmentMemory();
 	draw();
-	vkDeviceWaitIdle(device);
-	if (!paused)
-	{
-		updateUniformBuffers();
-	}
 }
 
-void VulkanExample::viewChanged()
+void VulkanExample::windowResized()
 {
-	updateUniformBuffers();
+	// The object buffer has one slice per swap chain image, the number of images may change with the swap chain
+	if (objectData.sliceCount == swapChain.imageCount)
+	{
+		return;
+	}
+	prepareObjectBuffer();
+	prepareInstanceBuffer();
+	for (auto& model : models)
+	{
+		model->updateDescriptorSet(&objectData.uniformDescriptor, getObjectStorageDescriptor());
+	}
+	for (auto& stage : cullingStages)
+	{
+		stage->resize(swapChain.imageCount);
+	}
+	// The command buffers have already been invalidated by the base class and read the new buffers when they are recorded
 }
 
 void VulkanExample::keyPressed(uint32_t keyCode)
@@ -534,7 +1431,62 @@ void VulkanExample::keyPressed(uint32_t keyCode)
 		if (deviceFeatures.fillModeNonSolid)
 		{
 			wireframe = !wireframe;
-			reBuildCommandBuffers();
+			// All segments are recorded with the pipeline of the current fill mode
+			invalidateCommandBuffers(true);
+		}
+		break;
+	case KEY_T:
+		// Only changes how dirty segments are recorded, the recorded commands stay the same
+		multiThreaded = !multiThreaded;
+		updateTextOverlay();
+		break;
+	case KEY_I:
+		if (indirectSupported)
+		{
+			indirect = !indirect;
+			invalidateCommandBuffers(false);
+			updateTextOverlay();
+		}
+		break;
+	case KEY_N:
+		if (instancedSupported)
+		{
+			instanced = !instanced;
+			invalidateCommandBuffers(false);
+			updateTextOverlay();
+		}
+		break;
+	case KEY_C:
+		if (pushConstantsSupported)
+		{
+			pushConstants = !pushConstants;
+			// Segments are recorded with different pipelines and per draw data
+			invalidateCommandBuffers(true);
+			updateTextOverlay();
+		}
+		break;
+	case KEY_L:
+		specular = !specular;
+		// All draws use the variant with the current shader features
+		invalidateCommandBuffers(true);
+		updateTextOverlay();
+		break;
+	case KEY_B:
+		if (bindlessSupported)
+		{
+			bindless = !bindless;
+			// Only the indirect paths use the texture table, the direct segments stay valid
+			invalidateCommandBuffers(false);
+			updateTextOverlay();
+		}
+		break;
+	case KEY_G:
+		if (gpuCullingSupported)
+		{
+			gpuCulling = !gpuCulling;
+			// The frustum of a culling slice is updated each frame before the slice is used
+			invalidateCommandBuffers(false);
+			updateTextOverlay();
 		}
 		break;
 	}
@@ -542,8 +1494,67 @@ void VulkanExample::keyPressed(uint32_t keyCode)
 
 void VulkanExample::getOverlayText(VulkanTextOverlay* textOverlay)
 {
+	VulkanExampleBase::getOverlayText(textOverlay);
+
 	if (deviceFeatures.fillModeNonSolid)
 	{
 		textOverlay->addText("Press \"w\" to toggle wireframe", 5.0f, 85.0f, VulkanTextOverlay::alignLeft);
 	}
+
+	std::stringstream ss;
+	ss << "Press \"t\" to toggle multithreaded recording (" << (multiThreaded ? numThreads : 1) << (multiThreaded ? " threads)" : " thread)");
+	textOverlay->addText(ss.str(), 5.0f, 105.0f, VulkanTextOverlay::alignLeft);
+
+	if (indirectSupported)
+	{
+		textOverlay->addText(indirect ? "Press \"i\" to toggle indirect drawing (on)" : "Press \"i\" to toggle indirect drawing (off)", 5.0f, 125.0f, VulkanTextOverlay::alignLeft);
+	}
+
+	if (gpuCullingSupported)
+	{
+		textOverlay->addText(gpuCulling ? "Press \"g\" to toggle GPU culling (on)" : "Press \"g\" to toggle GPU culling (off)", 5.0f, 145.0f, VulkanTextOverlay::alignLeft);
+	}
+
+	if (instancedSupported)
+	{
+		textOverlay->addText(instanced ? "Press \"n\" to toggle instanced drawing (on)" : "Press \"n\" to toggle instanced drawing (off)", 5.0f, 165.0f, VulkanTextOverlay::alignLeft);
+	}
+
+	if (pushConstantsSupported)
+	{
+		textOverlay->addText(pushConstants ? "Press \"c\" to toggle push constants (on)" : "Press \"c\" to toggle push constants (off)", 5.0f, 185.0f, VulkanTextOverlay::alignLeft);
+	}
+
+	if (bindlessSupported)
+	{
+		textOverlay->addText(bindless ? "Press \"b\" to toggle bindless textures (on)" : "Press \"b\" to toggle bindless textures (off)", 5.0f, 205.0f, VulkanTextOverlay::alignLeft);
+	}
+
+	textOverlay->addText(specular ? "Press \"l\" to toggle specular highlights (on)" : "Press \"l\" to toggle specular highlights (off)", 5.0f, 225.0f, VulkanTextOverlay::alignLeft);
+
+	// GPU culling statistics are read back asynchronously and lag behind by the number of swap chain images
+	size_t visibleCount = gpuCulling ? gpuCullingStats.drawCount : visibleObjects.size();
+	ss.str("");
+	ss << "Visible objects: " << visibleCount << ", culled: " << (objects.size() - visibleCount);
+	textOverlay->addText(ss.str(), 5.0f, 245.0f, VulkanTextOverlay::alignLeft);
+
+	// Variants created on first use stalled the frame that needed them
+	vks::PipelineVariants::Statistics variantStats = pipelineVariants.getStatistics();
+	ss.str("");
+	ss << std::fixed << std::setprecision(1) << "Pipeline variants: " << variantStats.createdOnDemand << " on demand (" << variantStats.onDemandMilliseconds << " ms), " << variantStats.compiledInBackground << " in background (" << variantStats.backgroundMilliseconds << " ms), " << variantStats.pending << " pending";
+	textOverlay->addText(ss.str(), 5.0f, 265.0f, VulkanTextOverlay::alignLeft);
+
+	if (!indirect && !gpuCulling && !instanced)
+	{
+		// Statistics of the last recorded command buffer
+		ss.str("");
+		ss << "Binds: " << renderQueueStats.pipelineBinds << " pipeline, " << renderQueueStats.descriptorSetBinds << " set, " << renderQueueStats.vertexBufferBinds << " buffer, " << renderQueueStats.pushConstantUpdates << " push constants";
+		textOverlay->addText(ss.str(), 5.0f, 285.0f, VulkanTextOverlay::alignLeft);
+		ss.str("");
+		ss << "Skipped: " << renderQueueStats.pipelineBindsSkipped << " pipeline, " << renderQueueStats.descriptorSetBindsSkipped << " set, " << renderQueueStats.vertexBufferBindsSkipped << " buffer";
+		textOverlay->addText(ss.str(), 5.0f, 305.0f, VulkanTextOverlay::alignLeft);
+		ss.str("");
+		ss << "Segments re-recorded: " << segmentsRecorded << " of " << (frameCommands.empty() ? 0 : frameCommands[0].segments.size());
+		textOverlay->addText(ss.str(), 5.0f, 325.0f, VulkanTextOverlay::alignLeft);
+	}
 }
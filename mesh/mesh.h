@@ -28,11 +28,21 @@
 #include <vulkan/vulkan.h>
 #include "vulkanexamplebase.h"
 #include "VulkanTexture.hpp"
+#include "threadpool.hpp"
+#include "frustum.hpp"
+#include "VulkanComputeCulling.hpp"
+#include "VulkanRenderQueue.hpp"
+#include "VulkanPipelineBatch.hpp"
+#include "VulkanShaderReflection.hpp"
+#include "VulkanBindlessTextures.hpp"
+#include "VulkanPipelineVariants.hpp"
+#include "VulkanRenderGraph.hpp"
 
 #include "Utilities.h"
 #include "Model.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
 #define ENABLE_VALIDATION false
 
 class VulkanExample : public VulkanExampleBase
@@ -47,8 +57,171 @@ public:
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 	} vertices;
 
+	// Vertex input of the instanced pipelines, adds a per instance binding to the vertex layout
+	struct
+	{
+		VkPipelineVertexInputStateCreateInfo inputState;
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	} instancedVertices;
+
 	std::vector<Model*> models;
-	Pipelines pipelines;
+
+	// Pipelines are created per program, fill mode and shader features on first use
+	vks::PipelineVariants pipelineVariants;
+	PipelinePrograms programs;
+	// Shade with specular highlights, selected with a specialization constant (toggle with "l")
+	bool specular = true;
+	// Compile variants that haven't been used before on a background thread and draw with the program's default variant until they are ready
+	// Otherwise recording stalls until the variant has been created
+	bool asyncPipelines = true;
+
+	// An instance of a model placed in the scene
+	struct SceneObject
+	{
+		uint32_t model;
+		glm::vec3 position;
+	};
+	// Objects are sorted by model, so all objects of a model can be drawn with consecutive indirect commands
+	std::vector<SceneObject> objects;
+	// Number of objects along each axis of the grid the scene is made of (set with "-objectgrid n")
+	uint32_t objectGridSize = 1;
+	static const uint32_t maxObjectGridSize = 64;
+
+	// Per object shader data of all objects, one slice per swap chain image
+	struct
+	{
+		vks::Buffer buffer;
+		uint32_t sliceCount = 0;
+		// Size of a slice, holds the entries of all objects followed by the scene entry
+		VkDeviceSize sliceSize = 0;
+		// Covers the data of a single object (uniform buffer) or of all objects in a slice (storage buffer)
+		VkDescriptorBufferInfo uniformDescriptor;
+		VkDescriptorBufferInfo storageDescriptor;
+	} objectData;
+
+	// Draw all objects from a buffer of indirect draw commands (toggle with "i")
+	bool indirect = false;
+	bool indirectSupported = false;
+	// One command per object, the first instance selects the object's entry in the storage buffer
+	vks::Buffer indirectCommands;
+
+	// Draws and (skipped) binds of the last recorded command buffer
+	vks::RenderQueue::Statistics renderQueueStats;
+
+	// Depth range of the camera
+	float zNear = 0.1f;
+	float zFar = 256.0f;
+
+	// Camera and scene transformations of the current frame
+	struct
+	{
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 world;
+	} sceneMatrices;
+
+	// Objects outside of the view frustum are culled each frame
+	vks::Frustum frustum;
+	// Static bounding spheres of the objects in scene space (structure of arrays for the batch test)
+	struct
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+		// One bit per object, written by the batch test
+		std::vector<uint32_t> visibility;
+	} objectBounds;
+	// Indices of the objects that passed culling in the current frame
+	std::vector<uint32_t> visibleObjects;
+
+	// The direct path records the draws of a fixed range of objects into a secondary command buffer (segment)
+	// Only segments whose visible objects or state have changed are re-recorded, the primary command buffer stitches them together
+	struct CommandSegment
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// Range of object indices [firstObject, lastObject) covered by the segment
+		uint32_t firstObject = 0;
+		uint32_t lastObject = 0;
+		// Worker thread whose pool the command buffer has been allocated from
+		uint32_t thread = 0;
+		// Visible objects of the range the segment has been recorded with
+		std::vector<uint32_t> objects;
+		// Set if the recorded commands are outdated (e.g. by a pipeline change) regardless of the visible objects
+		bool dirty = true;
+		vks::RenderQueue::Statistics stats;
+	};
+	// Command buffer state of a swap chain image
+	struct FrameCommands
+	{
+		std::vector<CommandSegment> segments;
+		// Visible objects the primary command buffer has been recorded with
+		std::vector<uint32_t> objects;
+		// Set if the primary command buffer has to be recorded again before the image is used
+		bool dirty = true;
+		// Passes recorded into the primary command buffer, rebuilt with each recording
+		vks::RenderGraph graph;
+	};
+	std::vector<FrameCommands> frameCommands;
+	// Number of objects per segment, smaller segments mean less work per change but more secondary command buffers
+	uint32_t objectsPerSegment = 64;
+	// Number of model descriptor sets per descriptor pool
+	uint32_t modelSetsPerPool = 32;
+	// Segments re-recorded by the last update
+	uint32_t segmentsRecorded = 0;
+
+	// Draw all visible objects of a model with a single instanced draw (toggle with "n")
+	bool instanced = false;
+	bool instancedSupported = false;
+	// Per instance vertex data with the object index of each instance, one slice per swap chain image
+	// A slice holds the visible objects the image's command buffer has been recorded with
+	struct
+	{
+		vks::Buffer buffer;
+		uint32_t sliceCount = 0;
+	} instanceData;
+
+	// Pass the per object transform of the direct draws as push constants and bind one descriptor set per model (toggle with "c")
+	// Per object data no longer needs to be written each frame, the camera matrices are read from the scene entry of the object data slice
+	bool pushConstants = false;
+	bool pushConstantsSupported = false;
+
+	// Cull the objects on the GPU and draw the visible ones with compacted indirect commands (toggle with "g")
+	bool gpuCulling = false;
+	bool gpuCullingSupported = false;
+	// Sample the color maps of the indirect and GPU culled draws from a bindless texture table (toggle with "b")
+	// The material index of each object is part of its object data, so the descriptor sets are only bound once instead of once per model
+	bool bindless = false;
+	bool bindlessSupported = false;
+	vks::BindlessTextureTable bindlessTextures;
+	// Number of entries of the bindless texture table (clamped to the device limits)
+	uint32_t maxBindlessTextures = 1024;
+
+	// One culling stage per model, as each model is drawn with it's own buffers
+	std::vector<vks::ComputeCulling*> cullingStages;
+	// Summed up statistics of all culling stages, read back from the frame that last used the current swap chain image
+	vks::ComputeCulling::Statistics gpuCullingStats = {};
+
+	// Record the dirty segments of the draw list on multiple threads (toggle with "t")
+	bool multiThreaded = true;
+	vks::ThreadPool threadPool;
+	uint32_t numThreads = 1;
+
+	// Each worker thread records into command buffers from its own pool (pools can't be used concurrently)
+	struct ThreadData
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// Sorts the draws of the segment being recorded to minimize state changes
+		vks::RenderQueue renderQueue;
+	};
+	std::vector<ThreadData> threadData;
+
+	// Upper limit for the bytes moved by a single device memory defragmentation step
+	VkDeviceSize defragmentationBudget = 4 * 1024 * 1024;
+
+	// Resources used by the shaders of all pipelines, the descriptor set and pipeline layouts and the pool sizes are generated from it
+	vks::ShaderReflection shaderReflection;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
@@ -60,34 +233,115 @@ public:
 
 	virtual void getEnabledFeatures();
 
-	void reBuildCommandBuffers();
+	// Mark the primary command buffers of all swap chain images (and optionally all segments) for recording before their next use
+	void invalidateCommandBuffers(bool segments);
 
+	// Invalidate all command buffers, they are recorded lazily in draw()
 	void buildCommandBuffers();
 
+	// Record the primary command buffer of a single swap chain image with the current set of visible objects
+	void buildCommandBuffer(uint32_t imageIndex);
+
+	// Re-record the dirty segments and the primary command buffer of a swap chain image if required
+	void updateCommandBuffer(uint32_t imageIndex);
+
+	// Fill a render queue with the draws of the given objects using the object data slice of the given swap chain image
+	void queueObjects(vks::RenderQueue &queue, uint32_t imageIndex, const std::vector<uint32_t> &drawObjects);
+
+	// Record the sorted draws of a render queue
+	void recordObjects(VkCommandBuffer commandBuffer, const vks::RenderQueue &queue, vks::RenderQueue::Statistics *stats);
+
+	// Record the draw commands for all visible objects with one indirect draw per run of consecutive objects
+	void recordIndirect(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Record the draw commands for all visible objects with one instanced draw per run of objects of the same model
+	void recordInstanced(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Record the draws of the objects that passed GPU culling (the culling dispatches have to be recorded before the render pass)
+	void recordGpuCulled(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Create the per thread command pools and allocate the segments of all swap chain images
+	void prepareCommandSegments();
+
+	// Record the secondary command buffer of a segment (called from the worker thread owning the segment's pool)
+	void recordCommandSegment(uint32_t imageIndex, uint32_t segmentIndex, VkCommandBufferInheritanceInfo inheritanceInfo);
+
+	// Compare the visible objects of all segments with the recorded ones and re-record the changed segments, returns true if any segment changed
+	bool updateCommandSegments(uint32_t imageIndex);
+
 	// Load a model from file using the ASSIMP model loader and generate all resources required to render the model
 	void loadModel(std::string filename, Model& model);
 
 	void loadAssets();
 
+	// Place the objects of the scene on a grid
+	void setupObjects();
+
+	// Create the per object data buffer with one slice per swap chain image (recreates the buffer if it already exists)
+	void prepareObjectBuffer();
+
+	// Create the per instance vertex buffer with one slice per swap chain image (recreates the buffer if it already exists)
+	void prepareInstanceBuffer();
+
+	// Dynamic offsets of an object's uniform data and of the storage buffer slice for the given swap chain image
+	// Passing the number of objects as the object index selects the scene entry
+	void getObjectOffsets(uint32_t imageIndex, size_t object, uint32_t *dynamicOffsets);
+
+	// Generate the indirect draw commands for all objects and upload them to a device local buffer
+	void prepareIndirectCommands();
+
+	// Create the GPU culling stages with the bounding spheres of all objects
+	void prepareGpuCulling();
+
+	// Update the frustum of the GPU culling stages and read back the statistics of the current swap chain image
+	void updateGpuCulling();
+
+	// Create the bindless texture table and register the color maps of all models (if descriptor indexing is supported)
+	void prepareBindlessTextures();
+
+	// Bind the descriptor sets of the indirect draw paths, returns true if the bindless table has been bound (no per model sets needed)
+	bool bindIndirectDescriptorSets(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
 	void setupVertexDescriptions();
 
+	// Set up the allocator for the model descriptor sets with the pool sizes of the reflected layout
 	void setupDescriptorPool();
 
+	// Create the descriptor set and pipeline layouts from the bindings and push constant ranges of the shaders
 	void setupDescriptorSetLayout();
 
+	// Storage buffer descriptor of the object data, null if no shader reads it
+	VkDescriptorBufferInfo* getObjectStorageDescriptor();
+
 	void setupDescriptorSet();
 
+	// Register the pipeline programs and create the variants used by default and by previous runs
 	void preparePipelines();
 
+	// Get the pipeline variant of a program for the current fill mode and shader features (created on first use)
+	// With asynchronous compilation the prewarmed default variant of the program is returned while the variant is being compiled
+	VkPipeline getPipeline(uint32_t program);
+
+	// File the list of used pipeline variants is stored in between runs (next to the pipeline cache)
+	std::string getPipelineVariantsFile();
+
+	void updateSceneMatrices();
+
+	// Test the bounding spheres of all objects against the view frustum and collect the visible ones
+	void cullObjects();
+
 	void updateUniformBuffers();
 
+	// Start a device memory defragmentation step, or finish the pending one once its copies have executed and update descriptors and command buffers of moved resources
+	void defragmentMemory();
+
 	void draw();
 
 	void prepare();
 
 	virtual void render();
 
-	virtual void viewChanged();
+	virtual void windowResized();
 
 	virtual void keyPressed(uint32_t keyCode);
 